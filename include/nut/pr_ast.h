@@ -24,6 +24,8 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <new>
+#include <cstddef>
 
 //!
 //! pr_ast
@@ -38,6 +40,10 @@
 //! The nodes are defined in pr_ast_nodes.inc w/ the DECL_NODE macro.
 //! This file is included several times below in order to build up enumeration constants, casting pointers
 //!   and public node structures.
+//!
+//! Nodes are allocated in the arena of their compilation (see ast_arena), along with
+//!   their children lists and names : they are never freed one by one, but all at once
+//!   with the parsing context.
 
 namespace pr
 {
@@ -49,22 +55,104 @@ namespace pr
     };
     #undef DECL_NODE
     
+    //! Number of bytes in an arena slab.
+    #define AST_ARENA_SLAB_SIZE 65536
+    
+    //! An arena, from which the nodes of an AST (and their children lists and names)
+    //!   are allocated.
+    //! Memory is handed out from slabs, and never released individually : a node
+    //!   removed from the AST stays in the arena, and everything is released at once
+    //!   by ast_arena_free, without running any destructor.
+    //! Arenas are not thread-safe.
+    //!
+    //! slabs:    the allocated slabs
+    //! used:     number of bytes handed out from the last slab
+    //! capacity: number of bytes in the last slab
+    struct ast_arena
+    {
+        std::vector<char*> slabs;
+        int used;
+        int capacity;
+    };
+    
+    //! Create an empty arena.
+    ast_arena ast_arena_create();
+    
+    //! Get size bytes from an arena, suitably aligned for any node.
+    void* ast_arena_alloc(ast_arena& arena, int size);
+    
+    //! Copy a string into an arena.
+    char const* ast_arena_string(ast_arena& arena, std::string const& str);
+    
+    //! Release all the memory of an arena.
+    void ast_arena_free(ast_arena& arena);
+    
+    //! A standard allocator taking its memory from an arena, for the children lists.
+    //! Memory given back when a list grows stays in the arena.
+    template <typename T>
+    struct ast_allocator
+    {
+        typedef T value_type;
+        
+        ast_allocator(ast_arena* arena) : arena(arena) {}
+        
+        template <typename U>
+        ast_allocator(ast_allocator<U> const& other) : arena(other.arena) {}
+        
+        T* allocate(std::size_t count)
+        {
+            return static_cast<T*>(ast_arena_alloc(*arena, count * sizeof(T)));
+        }
+        
+        void deallocate(T*, std::size_t)
+        { }
+        
+        ast_arena* arena;
+    };
+    
+    template <typename T, typename U>
+    bool operator==(ast_allocator<T> const& a, ast_allocator<U> const& b)
+    {
+        return a.arena == b.arena;
+    }
+    
+    template <typename T, typename U>
+    bool operator!=(ast_allocator<T> const& a, ast_allocator<U> const& b)
+    {
+        return a.arena != b.arena;
+    }
+    
+    //! The part of a token saved by a node : its type, its location and its length.
+    //! It owns no memory, unlike the token's value.
+    struct ast_token
+    {
+        ast_token(token const& tok) : type(tok.type), info(tok.info), length(tok.value.size()) {}
+        
+        int type;
+        token_info info;
+        int length;
+    };
+    
     //! Forward declaration of node struct's.
     #define DECL_NODE(tag_name, name, members) struct name ## _node;    
     #include "nut/pr_ast_nodes.inc"
     #undef DECL_NODE
     
+    struct ast_node;
+    
+    //! A list of children nodes, allocated in an arena.
+    typedef std::vector<ast_node*, ast_allocator<ast_node*> > ast_node_list;
+    
     //! Ast node structure.
     struct ast_node
     {
-        ast_node(token const& tok);
-        virtual ~ast_node();
+        ast_node(ast_arena& arena, ast_token const& tok);
         
         //! Tag enumeration for cast.
         int tag;
         
         //! Saved token, from which this node originates.
-        token saved_tok;
+        ast_token saved_tok;
         
         //! These pointers are init'ed to 0,
         //!   and updated by the pass_fix_ast pass.
@@ -78,6 +166,7 @@ namespace pr
         
         //! This is the declarator eventually associated to this node.
         //! It is init'ed to 0, and eventually set by pass_create_declarators.
+        //! It is owned by the semantic context, not by the node.
         sem::declarator* decl;
         //! The result type of the expression, if applicable (statements will get res_tp == 0
         //!   for example).
@@ -85,8 +174,8 @@ namespace pr
         //! It is NEVER deallocated (it should point to a node.decl declarator).
         sem::type* res_tp;
         
-        //! Children nodes vector.
-        std::vector<ast_node*> children;
+        //! Children nodes vector, allocated in the node's arena.
+        ast_node_list children;
         
         //! Union containing automatically casted pointers to
         //!   specialized nodes.
@@ -104,7 +193,7 @@ namespace pr
     #define DECL_NODE(tag_name, name, members) \
         struct name ## _node : public ast_node \
         { \
-            name ## _node(token tok) : ast_node(tok) { tag = tag_name; } \
+            name ## _node(ast_arena& arena, ast_token const& tok) : ast_node(arena, tok) { tag = tag_name; } \
             members \
         };
     #include "nut/pr_ast_nodes.inc"
@@ -116,11 +205,31 @@ namespace pr
     //! Print an AST tree in a human-readable format.
     void ast_pretty_print(ast_node* root, std::ostream& os = std::cout);
     
-    //! Delete an AST tree.
-    void ast_free(ast_node* root);
+    //! Create a node in an arena, from the token it originates from.
+    template <typename T>
+    T* ast_create(ast_arena& arena, ast_token const& tok)
+    {
+        return new (ast_arena_alloc(arena, sizeof(T))) T(arena, tok);
+    }
     
     //! Add a children to an AST node.
+    //! Null children (the result of failed parsing rules) are ignored.
     void ast_add_child(ast_node* node, ast_node* child);
+    
+    //! Replace a node by another one in its parent, taking its parent, prev and next pointers.
+    //! The replaced node is detached, but not freed.
+    void ast_replace(ast_node* node, ast_node* by);
+    
+    //! Get the name of the function called by a FUNCTION_CALL_EXPR node.
+    //! Returns an empty string if the called object is not an identifier.
+    std::string ast_callee_name(ast_node* call);
+    
+    //! Get the argument expressions of a FUNCTION_CALL_EXPR node, in order.
+    //! They are given as a left-leaning chain of LIST_EXPR nodes.
+    void ast_call_arguments(ast_node* call, std::vector<ast_node*>& args);
+    
+    //! Collect the FUNCTION_CALL_EXPR nodes of a subtree, in source order.
+    void ast_collect_calls(ast_node* root, std::vector<ast_node*>& calls);
 }
 
 #endif // NUT_PR_AST_H
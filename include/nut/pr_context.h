@@ -20,13 +20,19 @@
 #define NUT_PR_CONTEXT_H
 
 #include "nut/pr_scope.h"
+#include "nut/pr_diagnostics.h"
+#include "nut/pr_ast.h"
 
 //!
 //! pr_context
 //!
 
 //! This file defines the parsing context.
-//! It currently hold a single stack scope object.
+//! It holds a stack scope object, the diagnostics sink
+//!   shared by the parser and the semantic analyzer, and the arena of the AST.
+//! Freeing the context releases the whole AST at once.
+//! A compilation only writes to its own contexts (this one and the semantic
+//!   context, see sem_context.h), so independent compilations can run concurrently.
 
 namespace pr
 {
@@ -34,12 +40,14 @@ namespace pr
     struct context
     {
         scope scp;
+        diag_sink diags;
+        ast_arena arena;
     };
     
     //! Create an empty parsing context.
     context context_create();
     
-    //! Free a parsing context.
+    //! Free a parsing context, and the AST allocated in its arena.
     void context_free(context& ctx);
 }
 
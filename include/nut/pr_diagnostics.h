@@ -0,0 +1,138 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_PR_DIAGNOSTICS_H
+#define NUT_PR_DIAGNOSTICS_H
+
+#include "nut/pr_token.h"
+#include <string>
+#include <vector>
+#include <iostream>
+
+//!
+//! pr_diagnostics
+//!
+
+//! This module defines the diagnostics engine, shared by the parser and the
+//!   semantic analyzer.
+//! Diagnostics are recorded as compact structures (a message identifier from
+//!   pr_diagnostics.inc, a source range and some arguments) in a sink held by the
+//!   parsing context.
+//! Nothing is formatted nor printed until the sink is rendered, once at the
+//!   end of the compilation : diagnostics are then sorted by location, deduplicated,
+//!   eventually capped, and printed either for humans or for tools (JSON).
+//! Compilation steps that fail return a status (see parser_parse_program and
+//!   passman_run) once their errors are recorded : no exception is thrown.
+
+namespace pr
+{
+    //! Diagnostic kinds.
+    enum
+    {
+        DIAG_KIND_PARSE_ERROR,
+        DIAG_KIND_SEMANTIC_ERROR,
+        DIAG_KIND_WARNING
+    };
+    
+    //! Diagnostic message identifiers.
+    #define DECL_DIAG(id, kind, format) DIAG_ ## id,
+    enum
+    {
+        #include "nut/pr_diagnostics.inc"
+        
+        DIAG_COUNT
+    };
+    #undef DECL_DIAG
+    
+    //! Maximum number of arguments of a diagnostic.
+    #define DIAG_MAX_ARGS 3
+    
+    //! A diagnostic record.
+    //!
+    //! id:     message identifier (DIAG_* constants)
+    //! offset: offset of the diagnosed range in the source
+    //! length: length of the diagnosed range
+    //! args:   message arguments
+    struct diagnostic
+    {
+        int id;
+        int offset;
+        int length;
+        std::string args[DIAG_MAX_ARGS];
+    };
+    
+    //! Rendering formats.
+    //!
+    //! TEXT: human-readable, with the source line and a caret
+    //! JSON: an array of objects, one per diagnostic
+    enum
+    {
+        DIAG_FORMAT_TEXT,
+        DIAG_FORMAT_JSON
+    };
+    
+    //! The diagnostics sink.
+    //!
+    //! diags:     the recorded diagnostics, in emission order
+    //! errors:    number of errors recorded
+    //! format:    the rendering format
+    //! max_count: maximum number of rendered diagnostics (0 for no limit)
+    struct diag_sink
+    {
+        std::vector<diagnostic> diags;
+        int errors;
+        
+        int format;
+        int max_count;
+    };
+    
+    //! Create an empty diagnostics sink.
+    diag_sink diag_sink_create();
+    
+    //! Free a diagnostics sink.
+    void diag_sink_free(diag_sink& sink);
+    
+    //! Create a diagnostic about a token.
+    diagnostic diag_make(int id, token const& tok,
+                         std::string const& arg0 = "",
+                         std::string const& arg1 = "",
+                         std::string const& arg2 = "");
+    
+    //! Create a diagnostic about length characters of the source, from offset.
+    diagnostic diag_make(int id, int offset, int length,
+                         std::string const& arg0 = "",
+                         std::string const& arg1 = "",
+                         std::string const& arg2 = "");
+    
+    //! Get the kind of a diagnostic message (DIAG_KIND_* constants).
+    int diag_kind(int id);
+    
+    //! Check if a diagnostic is an error.
+    bool diag_is_error(diagnostic const& diag);
+    
+    //! Record a diagnostic in the sink.
+    void diag_emit(diag_sink& sink, diagnostic const& diag);
+    
+    //! Format a diagnostic's message (without location information).
+    std::string diag_message(diagnostic const& diag);
+    
+    //! Render the sink's diagnostics, given the whole source text.
+    void diag_render(diag_sink& sink, std::string const& source, std::ostream& os);
+}
+
+#endif // NUT_PR_DIAGNOSTICS_H
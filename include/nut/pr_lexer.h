@@ -32,6 +32,7 @@
 //! Tokens are defined in pr_token.h and pr_tokens.inc.
 //! Internally, simple tokens (i.e. single chars, operators, keywords, ...) are stored in tables.
 //! Valued tokens like identifiers, numeric literals, ... are hard-coded in the lexer.
+//! These tables are never modified, so independent lexers can run on different threads.
 
 namespace pr
 {
@@ -39,7 +40,7 @@ namespace pr
     //! It holds the input stream and a parsing context reference.
     struct lexer
     {
-        lexer(std::istream& in, context& ctx) : in(in), ctx(ctx) {};
+        lexer(std::istream& in, context& ctx) : in(in), ctx(ctx), timing(false), tokens(0), time(0) {};
         
         std::istream& in;
         context& ctx;
@@ -47,6 +48,12 @@ namespace pr
         int next_char;
         token next_token;
         token_info current_info;
+        
+        //! Lexing statistics : number of tokens extracted and time
+        //!   spent doing so (in seconds, only measured if timing is true).
+        bool timing;
+        int tokens;
+        double time;
     };
     
     //! Create a lexer from an input stream.
@@ -70,6 +77,10 @@ namespace pr
     //! Get the n-th line of the input stream.
     //! The lexing process is not affected.
     std::string lexer_getline(lexer& lex, int n);
+    
+    //! Get the whole content of the input stream.
+    //! The lexing process is not affected.
+    std::string lexer_getsource(lexer& lex);
 }
 
 #endif // NUT_PR_LEXER_H
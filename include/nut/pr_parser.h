@@ -54,10 +54,17 @@ namespace pr
     //! The parser structure, holding a lexer and a context reference.
     struct parser
     {
-        parser(lexer& lex, context& ctx) : lex(lex), ctx(ctx) {};
+        parser(lexer& lex, context& ctx) : lex(lex), ctx(ctx), failed(false), time(0) {};
         
         lexer& lex;
         context& ctx;
+        
+        //! Set on the first parse error : parsing rules then stop, drop their
+        //!   partial nodes and return 0, up to parser_parse_program.
+        bool failed;
+        
+        //! Time spent in parser_parse_program (in seconds), including lexing.
+        double time;
     };
     
     //! Create a parser entity based on a lexer and attached to a context.
@@ -67,6 +74,9 @@ namespace pr
     void parser_free(parser& par);
     
     //! Parse a program module.
+    //! Returns 0 on errors, which are recorded in the context's diagnostics sink.
+    //! No exception is thrown, and the nodes of failed rules are only released
+    //!   with the context (see ast_arena).
     ast_node* parser_parse_program(parser& par);
     
     //!
@@ -74,26 +84,24 @@ namespace pr
     //!   but by other parsing modules like pr_pratt.cpp.
     //!
     
-    //! Throw out an error, printing the message msg and location of the token tok.
-    void parser_parse_error(parser& par, token const& tok, std::string const& msg);
-    
-    //! Get an information string about the token location, in the format :
-    //! "line %line, col %column: "
-    std::string parser_token_information(token const& tok);
+    //! Record a parse error about the token tok in the context's diagnostics sink
+    //!   (unless an error was already recorded), and flag the parser as failed.
+    //! Returns 0, so that rules can return it as their (failed) result.
+    ast_node* parser_error(parser& par, token const& tok, int id,
+                           std::string const& arg0 = "",
+                           std::string const& arg1 = "",
+                           std::string const& arg2 = "");
     
-    //! Generate an line error information from the position in tok.
-    //! Format (abab... is the corresponding line of the input stream) :
-    //! abababababababababab
-    //! ~~~~~~~~~~~~~^
-    //! The caret is at tok.info.column.
-    std::string parser_error_line(parser& par, token const& tok);
+    //! Drop the partial node of a failed rule (it stays in the context's arena).
+    //! Returns 0, so that rules can return it as their (failed) result.
+    ast_node* parser_abort(ast_node* node);
     
     //! Check that the next token is of the given type.
-    //! Throw an error if it is not the case.
+    //! Records an error if it is not the case (or if the parser already failed).
     //! If err_msg is empty, it outputs the default error message (automatic), otherwise
     //!   it outputs err_msg.
     //! If eat == true, consume the token and return it.
-    //! If eat == false, the return value is uninitialized.
+    //! If eat == false (or on errors), the return value is uninitialized.
     token parser_expect(parser& par, int type, std::string const& err_msg = "", bool eat = true);
     //! Check an identifier token against multiple declarations.
     void parser_check_declaration(parser& par, token const& tok);
@@ -43,6 +43,7 @@ namespace pr
 {
     //! Parse an expression.
     //! This wraps the expression tree into an EXPRESSION node.
+    //! Returns 0 on errors (see parser_error).
     ast_node* expression(parser& par);
 }
 
@@ -49,9 +49,11 @@ namespace pr
     #undef DECL_TOKEN
     
     //! Information about a token's location in the input stream.
+    //! The offset is the index of the token's first character in the stream.
     struct token_info
     {
         int line, column;
+        int offset;
     };
     
     //! An (eventually) valued token.
@@ -0,0 +1,104 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_CALLGRAPH_H
+#define NUT_SEM_CALLGRAPH_H
+
+#include "nut/pr_ast.h"
+#include "nut/sem_declarator.h"
+#include <vector>
+#include <map>
+#include <iostream>
+#include <functional>
+
+//!
+//! sem_callgraph
+//!
+
+//! This module builds the call graph of a program, from the calls resolved by
+//!   pass_check_calls (see function::calls and declarator::uses).
+//! Its strongly connected components (mutually recursive functions) are ordered
+//!   bottom-up : callees come before their callers, so interprocedural analyses
+//!   can process each component once all the functions it calls are done.
+
+namespace sem
+{
+    //! A call graph edge.
+    //!
+    //! callee: the index of the called function
+    //! site:   the FUNCTION_CALL_EXPR node
+    struct call_edge
+    {
+        int callee;
+        pr::ast_node* site;
+    };
+    
+    //! A call graph node, one per function.
+    //!
+    //! fun:       the function declarator
+    //! node:      the FUNCTION_DECL node
+    //! callees:   the calls made by the function, in source order
+    //! callers:   the indices of the calling functions (without duplicates)
+    //! externals: the called functions of other modules (without duplicates)
+    //! scc:       the index of the function's component
+    struct call_node
+    {
+        function* fun;
+        pr::ast_node* node;
+        std::vector<call_edge> callees;
+        std::vector<int> callers;
+        std::vector<function*> externals;
+        int scc;
+    };
+    
+    //! The call graph structure.
+    //!
+    //! nodes:  the functions, in program order
+    //! index:  the function indices, by declarator
+    //! sccs:   the components (lists of function indices), in bottom-up order
+    //! levels: the components, grouped by level : the components of a level only
+    //!         call components of the previous levels, so they are independent
+    struct call_graph
+    {
+        std::vector<call_node> nodes;
+        std::map<function*, int> index;
+        std::vector<std::vector<int> > sccs;
+        std::vector<std::vector<int> > levels;
+    };
+    
+    //! Build the call graph of a program, once its calls have been checked.
+    //! The functions imported from other modules (see sem_summary.h) are not part
+    //!   of it, the calls to them are only recorded as externals.
+    call_graph call_graph_create(pr::ast_node* program, std::vector<function*> const& externals = std::vector<function*>());
+    
+    //! Free a call graph.
+    void call_graph_free(call_graph& graph);
+    
+    //! Check if a component is recursive (it has a cycle, possibly a
+    //!   single self-recursive function).
+    bool call_graph_is_recursive(call_graph& graph, int scc);
+    
+    //! Run task(scc) on each component bottom-up, on at most 'threads' threads.
+    //! A component is only started once all the components it calls are done.
+    void call_graph_run_bottom_up(call_graph& graph, int threads, std::function<void(int)> const& task);
+    
+    //! Print the components in bottom-up order, one per line.
+    void call_graph_dump(call_graph& graph, std::ostream& os);
+}
+
+#endif // NUT_SEM_CALLGRAPH_H
@@ -0,0 +1,99 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_CFG_H
+#define NUT_SEM_CFG_H
+
+#include "nut/pr_ast.h"
+#include <vector>
+#include <iostream>
+
+//!
+//! sem_cfg
+//!
+
+//! This module builds the control-flow graph of a function.
+//! Basic blocks are lists of simple statements (DECLARATION_STMT, RETURN_STMT and
+//!   expression statements), executed in order. A block ending with a jump (a
+//!   return) starts a new one, that is unreachable unless another edge reaches it.
+//!
+//! Everything is stored in contiguous arrays : each block refers to ranges of the
+//!   graph's statements, successors and predecessors arrays.
+
+namespace sem
+{
+    //! Special blocks : every function has an entry block (where the body starts)
+    //!   and an empty exit block (reached by returns and by the end of the body).
+    enum
+    {
+        CFG_ENTRY = 0,
+        CFG_EXIT  = 1
+    };
+    
+    //! A basic block.
+    //!
+    //! stmt_begin, stmt_end: the block's statements range in cfg::stmts
+    //! succ_begin, succ_end: the block's successors range in cfg::succs
+    //! pred_begin, pred_end: the block's predecessors range in cfg::preds
+    //! rpo:                  the block's reverse post-order number, -1 if unreachable
+    //! after:                the jump statement ending the textually preceding block,
+    //!                       if this block starts right after one (0 otherwise)
+    struct cfg_block
+    {
+        int stmt_begin, stmt_end;
+        int succ_begin, succ_end;
+        int pred_begin, pred_end;
+        int rpo;
+        pr::ast_node* after;
+    };
+    
+    //! A function control-flow graph.
+    //!
+    //! node:   the FUNCTION_DECL node
+    //! blocks: the basic blocks, in source order (entry and exit first)
+    //! stmts:  the statements of all blocks
+    //! succs:  the successors of all blocks
+    //! preds:  the predecessors of all blocks
+    //! rpo:    the reachable blocks, in reverse post-order
+    struct cfg
+    {
+        pr::ast_node* node;
+        std::vector<cfg_block> blocks;
+        std::vector<pr::ast_node*> stmts;
+        std::vector<int> succs;
+        std::vector<int> preds;
+        std::vector<int> rpo;
+    };
+    
+    //! Build the control-flow graph of a FUNCTION_DECL node.
+    cfg cfg_create(pr::ast_node* function);
+    
+    //! Free a control-flow graph.
+    void cfg_free(cfg& graph);
+    
+    //! Check if a block is reachable from the entry block.
+    inline bool cfg_reachable(cfg& graph, int block)
+    {
+        return graph.blocks[block].rpo >= 0;
+    }
+    
+    //! Print a control-flow graph, one block per line.
+    void cfg_dump(cfg& graph, std::ostream& os);
+}
+
+#endif // NUT_SEM_CFG_H
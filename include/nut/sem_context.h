@@ -0,0 +1,62 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_CONTEXT_H
+#define NUT_SEM_CONTEXT_H
+
+#include "nut/sem_declarator.h"
+#include "nut/sem_types.h"
+#include "nut/sem_ir.h"
+#include "nut/sem_summary.h"
+#include <string>
+#include <map>
+
+//!
+//! sem_context
+//!
+
+//! This file defines the semantic context, that owns everything the semantic
+//!   analyzer creates during a compilation : the type table, the pools
+//!   of variable and function declarators (and the index of the program's
+//!   functions), the IR of the program, and the summary of the modules it imports.
+//! Its contents live as long as the context, and are released all at once by
+//!   context_free (after the AST referencing them has been freed).
+
+namespace sem
+{
+    //! The semantic context structure.
+    struct context
+    {
+        type_table types;
+        pool<variable> variables;
+        pool<function> functions;
+        //! The functions declared by the program, by name (the first one if
+        //!   several have the same name).
+        std::map<std::string, function*> globals;
+        ir_program ir;
+        summary imports;
+    };
+    
+    //! Create a semantic context, holding only the built-in types.
+    context context_create();
+    
+    //! Free a semantic context, and all its declarators.
+    void context_free(context& ctx);
+}
+
+#endif // NUT_SEM_CONTEXT_H
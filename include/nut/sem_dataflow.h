@@ -0,0 +1,153 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_DATAFLOW_H
+#define NUT_SEM_DATAFLOW_H
+
+#include "nut/pr_ast.h"
+#include "nut/sem_declarator.h"
+#include "nut/sem_cfg.h"
+#include <vector>
+
+//!
+//! sem_dataflow
+//!
+
+//! This module implements a generic bit-vector dataflow solver over a function's
+//!   control-flow graph (see sem_cfg.h), and the classic problems built on it :
+//!   liveness, reaching definitions and definite assignment.
+//!
+//! A problem is given by its direction, its meet operator (union for "may"
+//!   problems, intersection for "must" problems), a boundary value, and the
+//!   gen and kill sets of each block : a block transforms its input X into
+//!   gen | (X & ~kill).
+//!
+//! Variables are identified by their index in their function (see variable::index),
+//!   so sets of variables are dense bit-vectors.
+
+namespace sem
+{
+    //! A dense bit-vector.
+    //!
+    //! size:  the number of bits
+    //! words: the bits, 64 per word
+    struct bitvec
+    {
+        int size;
+        std::vector<unsigned long long> words;
+    };
+    
+    //! Create a bit-vector of the given size, all bits being set to value.
+    bitvec bitvec_create(int size, bool value = false);
+    
+    //! Get a bit.
+    inline bool bitvec_get(bitvec const& bv, int i)
+    {
+        return (bv.words[i / 64] >> (i % 64)) & 1;
+    }
+    
+    //! Set (or clear) a bit.
+    inline void bitvec_set(bitvec& bv, int i, bool value = true)
+    {
+        if (value)
+            bv.words[i / 64] |= 1ull << (i % 64);
+        else
+            bv.words[i / 64] &= ~(1ull << (i % 64));
+    }
+    
+    //! Dataflow directions.
+    enum
+    {
+        DATAFLOW_FORWARD,
+        DATAFLOW_BACKWARD
+    };
+    
+    //! Dataflow meet operators.
+    enum
+    {
+        DATAFLOW_UNION,
+        DATAFLOW_INTERSECTION
+    };
+    
+    //! A dataflow problem, and its solution once solved.
+    //!
+    //! direction: DATAFLOW_FORWARD or DATAFLOW_BACKWARD
+    //! meet:      DATAFLOW_UNION or DATAFLOW_INTERSECTION
+    //! size:      the number of bits of the sets
+    //! boundary:  the input of the entry block (forward) or exit block (backward)
+    //! gen, kill: the transfer function of each block
+    //! in, out:   the solution, at the start and the end of each block (in execution order)
+    struct dataflow
+    {
+        int direction;
+        int meet;
+        int size;
+        
+        bitvec boundary;
+        std::vector<bitvec> gen;
+        std::vector<bitvec> kill;
+        
+        std::vector<bitvec> in;
+        std::vector<bitvec> out;
+    };
+    
+    //! Create a dataflow problem over a control-flow graph, with empty
+    //!   boundary, gen and kill sets.
+    dataflow dataflow_create(cfg& graph, int direction, int meet, int size);
+    
+    //! Solve a dataflow problem, with a worklist visiting blocks in reverse
+    //!   post-order (forward problems) or post-order (backward problems).
+    //! Unreachable blocks keep the neutral value of the meet operator.
+    void dataflow_solve(dataflow& df, cfg& graph);
+    
+    //! A variable access in a statement.
+    //!
+    //! var:  the variable index in its function
+    //! def:  true for a definition (assignment, initialization), false for a use
+    //! node: the IDENTIFIER_EXPR node (or the DECLARATION_STMT node, for initializations)
+    struct dataflow_access
+    {
+        int var;
+        bool def;
+        pr::ast_node* node;
+    };
+    
+    //! Get the variable accesses of each statement of a function's control-flow
+    //!   graph (indexed like cfg::stmts), in evaluation order.
+    //! The function's variable uses must have been resolved (see declarator::uses).
+    std::vector<std::vector<dataflow_access> > dataflow_accesses(cfg& graph, function* fun);
+    
+    //! Liveness : the variables whose value may be used later.
+    //! Backward, union over the function's variables.
+    dataflow dataflow_liveness(cfg& graph, function* fun,
+                               std::vector<std::vector<dataflow_access> > const& accesses);
+    
+    //! Reaching definitions : the definitions that may reach a point.
+    //! Forward, union over the definitions, numbered in sites.
+    dataflow dataflow_reaching_definitions(cfg& graph, function* fun,
+                                           std::vector<std::vector<dataflow_access> > const& accesses,
+                                           std::vector<dataflow_access>& sites);
+    
+    //! Definite assignment : the variables assigned on every path to a point.
+    //! Forward, intersection over the function's variables, arguments being
+    //!   assigned at entry.
+    dataflow dataflow_definite_assignment(cfg& graph, function* fun,
+                                          std::vector<std::vector<dataflow_access> > const& accesses);
+}
+
+#endif // NUT_SEM_DATAFLOW_H
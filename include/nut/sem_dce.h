@@ -0,0 +1,54 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_DCE_H
+#define NUT_SEM_DCE_H
+
+#include "nut/sem_ir.h"
+#include "nut/sem_callgraph.h"
+#include <vector>
+
+//!
+//! sem_dce
+//!
+
+//! This module implements dead code elimination on the IR functions in SSA form.
+//! Operations are assumed dead unless they have an effect (jumps, returns,
+//!   divisions that may trap and calls that can't be removed) or compute a value
+//!   used by a live operation : everything else is removed, as well as the
+//!   unreachable blocks.
+//! Variables being promoted to registers (see sem_ssa.h), a store to a local that
+//!   is never read is a dead register definition, so it goes away the same way.
+//!
+//! A call can be removed when its result is unused if its callee is pure and
+//!   surely returns, that is if it can't reach a recursive function : the language
+//!   has no loops, so recursion is the only way not to.
+
+namespace sem
+{
+    //! Find the functions whose calls can be removed when their result is unused,
+    //!   by index in ir_program::functions, from the call graph of the program.
+    std::vector<bool> dce_removable_calls(ir_program& ir, call_graph& graph);
+    
+    //! Remove the dead code of a function in SSA form, the calls to the functions
+    //!   flagged in 'removable' being removed when their result is unused.
+    //! Returns the number of removed pieces.
+    int dce_run(ir_program& ir, int fun, std::vector<bool> const& removable);
+}
+
+#endif // NUT_SEM_DCE_H
@@ -21,6 +21,7 @@
 
 #include <string>
 #include <vector>
+#include <algorithm>
 
 //!
 //! sem_declarator
@@ -29,6 +30,14 @@
 //! This module defines the declarator structures.
 //! A declarator is an object attached to an AST node (when the node declares something)
 //!   that contains semantic information about the latter declaration.
+//! Variable and function declarators are allocated in pools owned by the
+//!   semantic context (see sem_context.h), and released all at once with it.
+
+namespace pr
+{
+    //! Forward declaration.
+    struct ast_node;
+}
 
 namespace sem
 {
@@ -46,6 +55,9 @@ namespace sem
     struct function;
     
     //! A semantic declarator, (similar to pr::symbol).
+    //! Its uses are the nodes referencing it : IDENTIFIER_EXPR nodes for variables,
+    //!   and FUNCTION_CALL_EXPR nodes (the call sites) for functions, in source order.
+    //! They are recorded by the passes resolving them (see sem_passman.h).
     struct declarator
     {
         declarator();
@@ -53,6 +65,7 @@ namespace sem
         
         int tag;
         std::string name;
+        std::vector<pr::ast_node*> uses;
         
         union
         {
@@ -73,36 +86,144 @@ namespace sem
         TYPE_FLAG_NONE        = 0x0000
     };
     
+    //! Type kinds.
+    //!
+    //! BUILTIN:  a built-in scalar type (see sem_builtins.inc)
+    //! ARRAY:    an array of 'length' elements of type 'base'
+    //! FUNCTION: a function returning 'base', with the given argument types
+    enum
+    {
+        TYPE_KIND_BUILTIN,
+        TYPE_KIND_ARRAY,
+        TYPE_KIND_FUNCTION
+    };
+    
     //! A type declarator.
+    //! Types are canonical objects created by a type table (see sem_types.h),
+    //!   so they can be compared by pointer.
     struct type : public declarator
     {
         int flags;
+        
+        //! Identifier in the owning type table.
+        int id;
+        //! Kind from TYPE_KIND_* enumeration constants.
+        int kind;
+        
+        //! Derived types information, see the TYPE_KIND_* constants.
+        type* base;
+        int length;
+        std::vector<type*> arguments;
     };
     
     //! A variable declarator.
+    //! Its index is its position in its function's variables (-1 if not in a function).
     struct variable : public declarator
     {
         type* tp; //! this is not freed when declarator is destroyed.
+        int index;
+    };
+    
+    //! Function purity, from the least to the most effectful.
+    //!
+    //! PURE:       the result only depends on the arguments, and nothing else is
+    //!             read or written
+    //! READ_ONLY:  non-local state may be read, but not written
+    //! EFFECTFUL:  non-local state may be written (or the body was not analyzed)
+    enum
+    {
+        PURITY_PURE,
+        PURITY_READ_ONLY,
+        PURITY_EFFECTFUL
     };
     
     //! A function declarator.
+    //! Its purity is computed by the purity analysis (see sem_purity.h).
+    //! Its arguments are stored contiguously in the variables pool.
+    //! Its variables are its arguments followed by its local variables, in source order.
+    //! Its calls are the FUNCTION_CALL_EXPR nodes of its body, in source order.
     struct function : public declarator
     {
+        type* tp; //! the function type, this is not freed when declarator is destroyed.
         type* ret_tp; //! this is not freed when declarator is destroyed.
-        std::vector<variable*> arguments;
+        variable* arguments;
+        int argument_count;
+        std::vector<variable*> variables;
+        std::vector<pr::ast_node*> calls;
+        int purity;
     };
     
+    //! Number of objects in a pool slab.
+    #define POOL_SLAB_SIZE 256
+    
+    //! A typed object pool.
+    //! Objects are default-constructed in slabs, and handed out in contiguous runs.
+    //! They are never released individually, but all at once by pool_free.
+    //! Pools are not thread-safe.
+    //!
+    //! slabs:    the allocated slabs
+    //! used:     number of objects handed out from the last slab
+    //! capacity: number of objects in the last slab
+    template <typename T>
+    struct pool
+    {
+        std::vector<T*> slabs;
+        int used;
+        int capacity;
+    };
+    
+    //! Create an empty pool.
+    template <typename T>
+    pool<T> pool_create()
+    {
+        pool<T> pl;
+        pl.used = 0;
+        pl.capacity = 0;
+        return pl;
+    }
+    
+    //! Get count contiguous objects from a pool.
+    template <typename T>
+    T* pool_alloc(pool<T>& pl, int count = 1)
+    {
+        if (pl.used + count > pl.capacity)
+        {
+            pl.capacity = std::max(POOL_SLAB_SIZE, count);
+            pl.slabs.push_back(new T[pl.capacity]);
+            pl.used = 0;
+        }
+        
+        T* objs = pl.slabs.back() + pl.used;
+        pl.used += count;
+        return objs;
+    }
+    
+    //! Release all the objects of a pool.
+    template <typename T>
+    void pool_free(pool<T>& pl)
+    {
+        for (unsigned int i = 0; i < pl.slabs.size(); ++i)
+            delete[] pl.slabs[i];
+        
+        pl.slabs.clear();
+        pl.used = 0;
+        pl.capacity = 0;
+    }
+    
     //! Create a new type declarator.
     type* type_create(std::string const& name, int flags = 0);
     
-    //! Create a new variable declarator.
-    variable* variable_create(std::string const& name);
+    //! Delete a type declarator created by type_create.
+    void type_free(type* tp);
+    
+    //! Create a new variable declarator in the given pool.
+    variable* variable_create(pool<variable>& variables, std::string const& name);
     
-    //! Create a new function declarator.
-    function* function_create(std::string const& name);
+    //! Create count contiguous (unnamed) variable declarators in the given pool.
+    variable* variables_create(pool<variable>& variables, int count);
     
-    //! Delete a declarator.
-    void declarator_free(declarator* decl);
+    //! Create a new function declarator in the given pool.
+    function* function_create(pool<function>& functions, std::string const& name);
 }
 
 #endif // NUT_SEM_DECLARATOR_H
@@ -0,0 +1,97 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_EVAL_H
+#define NUT_SEM_EVAL_H
+
+#include "nut/pr_ast.h"
+#include "nut/sem_declarator.h"
+#include "nut/sem_callgraph.h"
+#include "nut/sem_cfg.h"
+#include <vector>
+#include <map>
+
+//!
+//! sem_eval
+//!
+
+//! This module evaluates calls to pure functions at compile time, by interpreting
+//!   their control-flow graphs (see sem_cfg.h).
+//! Only integer (and boolean) values are supported, with 32-bit wrapping arithmetic.
+//! Evaluation gives up on anything it can't decide at compile time : division by
+//!   zero, reading an unassigned variable, calling a function that is not pure,
+//!   or exceeding the step budget.
+
+namespace sem
+{
+    //! Default maximum number of evaluated expressions per evaluation.
+    #define EVAL_MAX_STEPS 100000
+    
+    //! Maximum call depth of an evaluation.
+    #define EVAL_MAX_DEPTH 256
+    
+    //! Wrapping arithmetic : truncate a result to 32 bits.
+    inline int eval_wrap(long long value)
+    {
+        return (int) (unsigned int) (unsigned long long) value;
+    }
+    
+    //! An interpreted function.
+    //!
+    //! graph:  the function's control-flow graph
+    //! locals: the variable indices, by IDENTIFIER_EXPR node
+    struct eval_function
+    {
+        cfg graph;
+        std::map<pr::ast_node*, int> locals;
+    };
+    
+    //! The evaluator structure.
+    //!
+    //! graph:     the call graph of the program, whose purity has been analyzed
+    //! callees:   the called functions, by call site
+    //! functions: the interpreted functions, built on demand
+    //! budget:    maximum number of evaluated expressions per evaluation
+    //! steps:     number of expressions evaluated by the current evaluation
+    //! depth:     current call depth
+    struct evaluator
+    {
+        call_graph* graph;
+        std::map<pr::ast_node*, function*> callees;
+        std::map<function*, eval_function> functions;
+        
+        int budget;
+        int steps;
+        int depth;
+    };
+    
+    //! Create an evaluator for a call graph, once purity_analyze has been ran on it.
+    evaluator evaluator_create(call_graph& graph, int budget = EVAL_MAX_STEPS);
+    
+    //! Free an evaluator.
+    void evaluator_free(evaluator& ev);
+    
+    //! Evaluate a call to a pure function with the given arguments.
+    //! Returns false if the result can't be computed.
+    bool evaluator_call(evaluator& ev, function* fun, std::vector<int> const& args, int& result);
+    
+    //! Forget about a call site, when it is removed from the AST.
+    void evaluator_forget(evaluator& ev, pr::ast_node* site);
+}
+
+#endif // NUT_SEM_EVAL_H
@@ -0,0 +1,47 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_GVN_H
+#define NUT_SEM_GVN_H
+
+#include "nut/sem_ir.h"
+
+//!
+//! sem_gvn
+//!
+
+//! This module implements global value numbering on the IR functions in SSA form,
+//!   as a walk of the dominator tree with a scoped table of the available values
+//!   (dominator-based value numbering).
+//! Operations are hashed by opcode and canonical operands (the operands of the
+//!   commutative ones being sorted), and an operation whose value is available
+//!   from a dominating block is removed, its register being replaced by the
+//!   available one.
+//! Calls to pure functions (see sem_purity.h) are numbered the same way, from the
+//!   callee and the arguments, as they always give the same result. Phis whose
+//!   values are all the same are replaced by that value.
+
+namespace sem
+{
+    //! Number the values of a function in SSA form, and remove the redundant
+    //!   operations.
+    //! Returns the number of removed operations (a call counts for one).
+    int gvn_run(ir_program& ir, int fun);
+}
+
+#endif // NUT_SEM_GVN_H
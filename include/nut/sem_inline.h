@@ -0,0 +1,68 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_INLINE_H
+#define NUT_SEM_INLINE_H
+
+#include "nut/sem_ir.h"
+#include "nut/sem_callgraph.h"
+
+//!
+//! sem_inline
+//!
+
+//! This module inlines calls on the IR functions in SSA form.
+//! The call graph's components are processed bottom-up, so a callee has had its
+//!   own calls inlined before it is inlined itself. Recursive functions are
+//!   never inlined, as their inlined body would call them again. Functions
+//!   imported from other modules (see sem_summary.h) are not part of the call
+//!   graph, but their bodies can be inlined too.
+//!
+//! A call is inlined if the callee is small enough, its size being the count of
+//!   its operations (without jumps and returns) :
+//!   - up to INLINE_BASE_SIZE, plus the cost of passing its arguments (one piece
+//!     each), as the call itself goes away,
+//!   - plus INLINE_CONSTANT_BONUS for each constant argument, as it is likely to
+//!     be folded into the inlined body,
+//!   - or up to INLINE_SINGLE_SITE_SIZE if it is the callee's only call site in
+//!     the program,
+//!   unless the caller would grow past INLINE_MAX_CALLER_SIZE.
+//! The functions that got calls inlined are then simplified again (constant
+//!   propagation, value numbering and dead code elimination).
+
+namespace sem
+{
+    //! Cost model parameters, in operations.
+    #define INLINE_BASE_SIZE 8
+    #define INLINE_CONSTANT_BONUS 4
+    #define INLINE_SINGLE_SITE_SIZE 64
+    #define INLINE_MAX_CALLER_SIZE 2048
+    
+    //! Get the size of a function in SSA form for the cost model, or -1 if it can't
+    //!   be inlined : its entry block must have no predecessor, and it must return,
+    //!   its returning blocks holding nothing but the return and each block jumping
+    //!   there setting the returned value. A tail call (see sem_tail.h) returns too.
+    int inline_cost(ir_program& ir, int fun);
+    
+    //! Inline the calls of the functions in SSA form, from the call graph of the
+    //!   program, and simplify the functions that changed.
+    //! Returns the number of inlined calls.
+    int inline_run(ir_program& ir, call_graph& graph);
+}
+
+#endif // NUT_SEM_INLINE_H
@@ -16,8 +16,14 @@
  * along with nut.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifndef SEM_IR_H
-#define SEM_IR_H
+#ifndef NUT_SEM_IR_H
+#define NUT_SEM_IR_H
+
+#include "nut/pr_ast.h"
+#include "nut/sem_declarator.h"
+#include <vector>
+#include <map>
+#include <iostream>
 
 //!
 //! sem_ir
@@ -29,62 +35,85 @@
 //!
 //! This IR is a medium-level one, that consists on a sequence of "pieces".
 //! Each piece is either a "label" or an "operation".
-//! An operation represents some work on "targets", and can be a high-level
-//!   operation like pushing a compound structure to the stack.
+//! An operation represents some work on "targets", and works on an operand
+//!   stack : its inputs are popped from it, and its result is pushed onto it.
 //! Therefore, at the generation time, an operation may translate
 //!   to several instructions.
 //! Some efforts are done to be as target independant as possible,
 //!   therefore the calling ABI is here abstracted through the OP_CALL, OP_POP_RET and
 //!   OP_PUSH_RET operations.
+//!
+//! The pieces of a whole program are stored in a single contiguous buffer, with
+//!   their targets inline : each function is a range of it. Its code is made of
+//!   basic blocks, starting with a label and ending with a jump (or a return, or
+//!   a tail call).
+//!
+//! Functions are lowered in stack form, then converted to SSA form (see sem_ssa.h) :
+//!   the stack and the variables are replaced by registers, each one assigned once,
+//!   and operations name their operands, their result register coming first.
 
 namespace sem
 {
-    //! Tag for the piece structure.
+    //! Maximum number of targets of an operation.
+    #define IR_MAX_TARGETS 3
+    
+    //! Tag for the target structure.
+    //!
+    //! CONSTANT: an integer constant (value)
+    //! LABEL:    a label of the current function (identifier)
+    //! OBJECT:   a variable of the current function (index, see variable::index)
+    //! FUNCTION: a function of the program (index in ir_program::functions)
+    //! REGISTER: a register of the current function, in SSA form (number)
     enum
     {
-        PIECE_LABEL,
-        PIECE_OPERATION
+        TG_CONSTANT,
+        TG_LABEL,
+        TG_OBJECT,
+        TG_FUNCTION,
+        TG_REGISTER
     };
     
-    //! An IR piece, that is either an operation (mapped
-    //!   at generation time to an instruction)
-    //!   or a label.
-    struct piece
+    //! An operation's target.
+    struct target
     {
-        piece();
-        virtual ~piece();
-        
-        //! Tag from PIECE_* enumeration constants.
+        //! Tag from TG_* enumeration constants.
         int tag;
-        
-        //! Automatic cast pointers.
-        union
-        {
-            piece* self;
-            label* as_label;
-            operation* as_operation;
-        };
+        int value;
     };
     
-    //! A label in the IR code.
-    //! They are dynamically allocated on request.
-    struct label : public piece
+    //! Tag for the piece structure.
+    enum
     {
-        int id;
+        PIECE_LABEL,
+        PIECE_OPERATION
     };
     
-    //! Forward declaration.
-    struct target;
-    
-    //! Tag for the operation structure.
+    //! Tag for the operations, in stack form.
     //!
-    //! PUSH:     push a target onto the stack (may be compound)
-    //! POP:      pop a target from the stack (")
+    //! PUSH:     push a target (constant or object) onto the stack
+    //! POP:      pop a value from the stack into a target (object), or drop it
+    //!           if there is none
     //! POP_RET:  pop a value from stack and set it to be returned by the current function
-    //!           TODO: how to determine the return value nature ???
     //! PUSH_RET: push the return value of the last called function to the stack
-    //!           TODO: how to determine the returned value's nature ??
-    //! CALL:     call the given function with the given arguments
+    //! CALL:     call a function (first target), its arguments (count given by the
+    //!           second target) being popped from the stack, the last one on top
+    //! ADD, SUB, MUL, DIV: pop the right then the left operand, push the result
+    //! NEG, NOT: pop the operand, push the result
+    //! JUMP:     jump to a label (target)
+    //! RETURN:   return from the current function
+    //! TAIL_CALL: call a function (targets as for CALL) reusing the current frame,
+    //!           its return value being returned by the current function ; this
+    //!           ends a basic block, as RETURN does (it is only introduced in SSA
+    //!           form, see sem_tail.h)
+    //!
+    //! In SSA form, values are constants or registers :
+    //!   - PUSH only passes the arguments of the following CALL (or TAIL_CALL), in order,
+    //!   - POP is not used, PUSH_RET and POP_RET have a single target (the register
+    //!     getting the return value, and the returned value),
+    //!   - arithmetic operations get their result register then their operands,
+    //!   - PHI gives its register (first target) the value (second target) coming
+    //!     from the block of the label (third target) : a phi is made of one piece
+    //!     per predecessor, consecutive with the same register, at the start of a block.
     enum
     {
         OP_PUSH,
@@ -97,33 +126,148 @@ namespace sem
         OP_ADD,
         OP_SUB,
         OP_MUL,
-        OP_DIV
+        OP_DIV,
+        OP_NEG,
+        OP_NOT,
+        
+        OP_JUMP,
+        OP_RETURN,
+        
+        OP_PHI,
+        
+        OP_TAIL_CALL
     };
     
-    //! An IR operation, that will be mapped later to some
-    //!   real instruction(s) at the generation process.
-    struct operation : public piece
+    //! An IR piece, that is either an operation (mapped
+    //!   at generation time to an instruction)
+    //!   or a label (its identifier being its only target).
+    struct piece
     {
-        //! Tag from OP_* enumeration constants.
+        //! Tag from PIECE_* enumeration constants.
         int tag;
+        //! Operation, from OP_* enumeration constants.
+        int op;
         
-        //! Targets of this instruction (mapped later to operands).
-        std::vector<target*> targets;
+        //! Targets of this piece (mapped later to operands).
+        int count;
+        target targets[IR_MAX_TARGETS];
     };
     
-    //! Tag for the operation's target structure.
-    enum
+    //! A function of the IR.
+    //!
+    //! fun:        the function declarator
+    //! node:       the FUNCTION_DECL node (0 for functions imported from other
+    //!             modules, see sem_summary.h)
+    //! lowered:    true if the function's body has been lowered
+    //! begin, end: the function's range in ir_program::pieces
+    //! labels:     the offset of each label in ir_program::pieces, by identifier
+    //!             (-1 until resolved by ir_resolve_labels)
+    //! ssa:        true if the function is in SSA form
+    //! registers:  the number of registers, in SSA form (the first ones hold the
+    //!             arguments on entry)
+    struct ir_function
     {
-        TG_CONSTANT,
-        TG_LABEL,
-        TG_OBJECT
+        function* fun;
+        pr::ast_node* node;
+        bool lowered;
+        int begin, end;
+        std::vector<int> labels;
+        bool ssa;
+        int registers;
     };
     
-    struct target
+    //! The IR of a program.
+    //!
+    //! pieces:    the pieces of all the functions
+    //! functions: the functions, in program order
+    //! index:     the function indices, by declarator
+    //! callees:   the called functions, by call site
+    struct ir_program
     {
-        //! Tag from TG_* enumeration constants.
-        int tag;
+        std::vector<piece> pieces;
+        std::vector<ir_function> functions;
+        std::map<function*, int> index;
+        std::map<pr::ast_node*, function*> callees;
     };
+    
+    //! Create the IR of a program (a PROGRAM_DECL node), once its calls have been checked.
+    //! Its functions are declared, but not lowered.
+    ir_program ir_create(pr::ast_node* program);
+    
+    //! Free the IR of a program.
+    void ir_free(ir_program& ir);
+    
+    //! Lower the body of a type-checked function, appending it to the pieces buffer.
+    //! Its labels are resolved.
+    void ir_lower(ir_program& ir, int fun);
+    
+    //! Replace the body of a function by new pieces, appended to the pieces buffer.
+    //! The buffer is compacted once mostly made of replaced bodies.
+    //! Its labels are resolved.
+    void ir_replace(ir_program& ir, int fun, std::vector<piece> const& body);
+    
+    //! Resolve the labels of a function, from its label pieces.
+    //! Throws if a label is used but not placed, or placed twice (internal error).
+    void ir_resolve_labels(ir_program& ir, int fun);
+    
+    //! Build a target.
+    inline target ir_target(int tag, int value)
+    {
+        target tg;
+        tg.tag = tag;
+        tg.value = value;
+        return tg;
+    }
+    
+    //! Check if an operation defines a register (its first target), in SSA form.
+    inline bool ir_defines(piece const& pc)
+    {
+        return pc.tag == PIECE_OPERATION &&
+               ((pc.op >= OP_ADD && pc.op <= OP_NOT) || pc.op == OP_PUSH_RET || pc.op == OP_PHI);
+    }
+    
+    //! A basic block of an IR function.
+    //!
+    //! begin, end:           the block's range in ir_program::pieces, from its label
+    //!                       to its jump (or return)
+    //! succ_begin, succ_end: the block's successors range in ir_graph::succs
+    //! pred_begin, pred_end: the block's predecessors range in ir_graph::preds
+    //! rpo:                  the block's reverse post-order number, -1 if unreachable
+    struct ir_block
+    {
+        int begin, end;
+        int succ_begin, succ_end;
+        int pred_begin, pred_end;
+        int rpo;
+    };
+    
+    //! The control-flow graph of an IR function.
+    //!
+    //! fun:    the function index
+    //! blocks: the basic blocks, in code order (the entry block first)
+    //! succs:  the successors of all blocks
+    //! preds:  the predecessors of all blocks
+    //! rpo:    the reachable blocks, in reverse post-order
+    //! labels: the block of each label, by identifier
+    struct ir_graph
+    {
+        int fun;
+        std::vector<ir_block> blocks;
+        std::vector<int> succs;
+        std::vector<int> preds;
+        std::vector<int> rpo;
+        std::vector<int> labels;
+    };
+    
+    //! Build the control-flow graph of a lowered function.
+    ir_graph ir_graph_create(ir_program& ir, int fun);
+    
+    //! Free an IR control-flow graph.
+    void ir_graph_free(ir_graph& graph);
+    
+    //! Print the lowered functions of the program (not the imported ones), one
+    //!   piece per line.
+    void ir_dump(ir_program& ir, std::ostream& os);
 }
 
-#endif // SEM_IR_H
+#endif // NUT_SEM_IR_H
@@ -21,6 +21,12 @@
 
 #include "nut/pr_ast.h"
 #include "nut/pr_parser.h"
+#include "nut/sem_types.h"
+#include "nut/sem_context.h"
+#include "nut/sem_workers.h"
+#include <string>
+#include <vector>
+#include <iostream>
 
 //!
 //! sem_passman
@@ -31,41 +37,230 @@
 
 namespace sem
 {
+    //! Pass identifiers enumeration constants.
+    #define DECL_PASS(id, name, order, flags, required, after) PASS_ ## id,
+    enum
+    {
+        #include "nut/sem_passes.inc"
+        
+        PASS_COUNT
+    };
+    #undef DECL_PASS
+    
+    //! Get the bit associated to a pass in a pass set.
+    #define PASS_MASK(id) (1u << (id))
+    
+    //! The set of all the built-in passes.
+    #define PASS_MASK_ALL (PASS_MASK(sem::PASS_COUNT) - 1)
+    
+    //! Pass traversal order.
+    //!
+    //! PRE:  the pass does its work when entering a node (before its children).
+    //! POST: the pass does its work when leaving a node (after its children).
+    enum
+    {
+        PASS_ORDER_PRE,
+        PASS_ORDER_POST
+    };
+    
+    //! Pass flags.
+    //!
+    //! LOCAL:  the pass does nothing on the PROGRAM_DECL node, and on a FUNCTION_DECL subtree
+    //!         it only writes to that subtree and reads the subtree and the global
+    //!         function declarators, so it can be ran concurrently on each function.
+    //! SERIAL: the pass changes the AST, it gets its own traversal, and a LOCAL one
+    //!         visits the functions one at a time (as a LOCAL pass, it may still be
+    //!         ran on a single function, or skip the unreached ones).
+    enum
+    {
+        PASS_FLAG_LOCAL  = 0x0001,
+        PASS_FLAG_SERIAL = 0x0002,
+        
+        PASS_FLAG_NONE   = 0x0000
+    };
+    
+    //! Special return values of the pass handlers.
+    //! Any other value returned by an enter handler is the index of the only child to visit.
+    //!
+    //! ALL:    visit all the node's children.
+    //! NONE:   don't visit the node's subtree at all.
+    //! FAILED: the pass failed on the node (its errors are recorded), it is stopped.
+    enum
+    {
+        PASS_VISIT_ALL  = -1,
+        PASS_VISIT_NONE = -2,
+        PASS_FAILED     = -3
+    };
+    
+    //! Maximum number of registered passes (they must fit in a pass set).
+    #define PASS_MAX 32
+    
+    //! Forward declaration.
+    struct passman;
+    
+    //! Per-pass statistics.
+    //!
+    //! time:        wall time spent in the pass handlers (in seconds, summed over
+    //!              worker threads), only measured when the pass manager's timing is enabled
+    //! nodes:       number of AST nodes visited
+    //! declarators: number of declarators created
+    struct pass_stats
+    {
+        double time;
+        unsigned long nodes;
+        unsigned long declarators;
+    };
+    
+    //! A pass object.
+    //! Passes are run as (possibly fused) AST traversals, calling for each node :
+    //!   - enter(node) before visiting its children, that returns the children
+    //!     to visit (see PASS_VISIT_*),
+    //!   - leave(node) after visiting them, if not null.
+    //! Both return PASS_FAILED on errors : passes report errors with status codes,
+    //!   exceptions are only used for internal errors.
+    //! See sem_passes.inc for the required and after pass sets.
+    struct pass
+    {
+        int id;
+        std::string name;
+        int order;
+        int flags;
+        unsigned int required;
+        unsigned int after;
+        
+        int (*enter)(passman&, pr::ast_node*);
+        int (*leave)(passman&, pr::ast_node*);
+        
+        //! Disabled passes are not ran (nor the passes that require them).
+        bool enabled;
+        pass_stats stats;
+    };
+    
     //! The pass manager structure.
-    //! It holds a parser structure to generate useful errors
-    //!   (it needs to read some lines upon generating messages).
+    //! It holds a parser structure to record diagnostics in its context,
+    //!   and the semantic context in which declarators are created.
+    //! It also holds the pass registry, built-in passes from sem_passes.inc
+    //!   being registered (in order) at creation.
     struct passman
     {
-        passman(pr::parser&);
+        passman(pr::parser&, context&);
         
         pr::parser& par;
+        context& ctx;
+        
+        //! Registered passes, indexed by identifier.
+        std::vector<pass> passes;
+        
+        //! The pass currently running.
+        int current;
+        //! Diagnostics emitted by each pass during the current traversal.
+        //! They are flushed in pass order to the context's sink once it completes.
+        std::vector<std::vector<pr::diagnostic> > diags;
+        
+        //! Declarator uses and function calls resolved during the current traversal.
+        //! They are added to the declarators (see sem_declarator.h) once it completes,
+        //!   as LOCAL passes may resolve uses of the same declarator concurrently.
+        std::vector<std::pair<declarator*, pr::ast_node*> > uses;
+        std::vector<std::pair<function*, pr::ast_node*> > calls;
+        
+        //! If true, measure the time spent in each pass.
+        bool timing;
+        
+        //! Maximum number of threads used to run the LOCAL passes
+        //!   (one function per task).
+        //! Diagnostics are still emitted in source order.
+        int jobs;
+        //! The worker threads running them, created by the first concurrent
+        //!   traversal and kept until the pass manager is freed.
+        worker_pool* workers;
+        
+        //! Root functions of the analysis.
+        //! If not empty, the LOCAL passes only analyze the bodies of the functions
+        //!   reachable through calls from these, while all function signatures are
+        //!   still declared.
+        std::vector<std::string> roots;
+        //! The functions of the program reachable from the roots, flagged once by
+        //!   passman_run for all its passes (see passman_reach_functions).
+        //! Empty if there are no roots.
+        std::vector<bool> reached;
     };
     
     //! Below are the semantic analyzer passes.
-    //! They are presented in order of execution.
+    //! They are presented in order of execution, and return false if they fail.
     //! Each pass assumes that the preceding ones have been ran,
     //!   without sanity checks, so please be careful !
     
-    //! Create a pass manager object.
-    passman passman_create(pr::parser& par);
+    //! Create a pass manager object, creating declarators in the given context.
+    passman passman_create(pr::parser& par, context& ctx);
     
     //! Free a pass manager object.
     void passman_free(passman& pman);
     
+    //! Register a new pass, to be ran after the already registered ones.
+    //! Its identifier is overwritten and returned.
+    int passman_register_pass(passman& pman, pass const& p);
+    
+    //! Find a registered pass by name.
+    //! Returns -1 if not found.
+    int passman_find_pass(passman& pman, std::string const& name);
+    
+    //! Get a registered pass from its identifier.
+    pass& passman_get_pass(passman& pman, int id);
+    
+    //! Enable or disable a registered pass.
+    void passman_enable_pass(passman& pman, int id, bool enabled = true);
+    
+    //! Get the set of all the registered passes.
+    unsigned int passman_all_passes(passman& pman);
+    
+    //! Flag the functions of a program that are reachable through calls from
+    //!   the pass manager's roots.
+    //! Calls are matched by name, which may over-approximate the reachable set
+    //!   (for ex. when a local variable shadows a function) but never misses a function.
+    //! Throws if a root is not a function of the program.
+    std::vector<bool> passman_reach_functions(passman& pman, pr::ast_node* node);
+    
+    //! Get the set of the registered passes that are not ran : the disabled ones,
+    //!   and the ones requiring them (directly or not).
+    //! Passes that only come after a disabled pass are still ran.
+    unsigned int passman_skipped_passes(passman& pman);
+    
+    //! Split a pass set into traversals.
+    //! Consecutive passes are fused in the same traversal as long as their
+    //!   requirements allow it.
+    //! Skipped passes (see passman_skipped_passes) are removed from the set.
+    //! Returns the pass sets of each traversal, in execution order.
+    std::vector<unsigned int> passman_schedule(passman& pman, unsigned int passes);
+    
+    //! Run a set of passes (in order) on the given AST, fusing their traversals.
+    //! The result is the same than running them one by one : when a pass fails,
+    //!   the error of the first failing pass (in execution order) is recorded, the
+    //!   diagnostics of the following ones are discarded and false is returned.
+    //! Traversals of LOCAL passes over a program are split across pman.jobs threads,
+    //!   and restricted to the functions reachable from pman.roots (if any), flagged
+    //!   once in pman.reached.
+    bool passman_run(passman& pman, unsigned int passes, pr::ast_node* node);
+    
     //! Run all passes (in order) on the given AST.
-    void passman_run_all(passman& pman, pr::ast_node* node);
+    //! Returns false if a pass failed.
+    bool passman_run_all(passman& pman, pr::ast_node* node);
+    
+    //! Print the time report, for lexing, parsing and each registered pass, in the format :
+    //! phase name    : wall time (percentage of the total) [counters]
+    void passman_time_report(passman& pman, std::ostream& os);
     
     //! Fix the AST parent, prev and next pointers.
-    void pass_fix_ast(passman& pman, pr::ast_node* node);
+    bool pass_fix_ast(passman& pman, pr::ast_node* node);
     
     //! Create declarators in the AST for types, variables and functions.
-    void pass_create_declarators(passman& pman, pr::ast_node* node);
+    bool pass_create_declarators(passman& pman, pr::ast_node* node);
     
     //! Check function calls :
     //!   - check if called object is an identifier
     //!   - check if called object is a function
     //!   - check call arity
-    void pass_check_calls(passman& pman, pr::ast_node* node);
+    //! It records the call sites of the functions, and the calls of each function.
+    bool pass_check_calls(passman& pman, pr::ast_node* node);
     
     //! Generate the expression result type information.
     //! It is located in node.res_tp.
@@ -73,7 +268,8 @@ namespace sem
     //!   - invalid use of identifers (for ex types and function names
     //!     are not allowed in arithmetic expressions)
     //!   - type incompatibilities in expressions (void = int, float + int, ...)
-    void pass_resolve_result_types(passman& pman, pr::ast_node* node);
+    //! It records the uses of the variables.
+    bool pass_resolve_result_types(passman& pman, pr::ast_node* node);
     
     //! Type-check pass.
     //! It checks :
@@ -81,15 +277,57 @@ namespace sem
     //!   - variables initialized w/ incompatible type
     //!   - function call arguments typing consistency
     //!   - return value type consistency
-    void pass_type_check(passman& pman, pr::ast_node* node);
+    bool pass_type_check(passman& pman, pr::ast_node* node);
     
     //! This pass checks for unused expression results
     //!   and emit warnings.
-    void pass_unused_expression_results(passman& pman, pr::ast_node* node);
+    bool pass_unused_expression_results(passman& pman, pr::ast_node* node);
     
-    //! This pass checks for unreachable code
+    //! This pass checks for unreachable code, on the control-flow
+    //!   graph of each function (see sem_cfg.h), and emit warnings.
+    bool pass_unreachable_code(passman& pman, pr::ast_node* node);
+    
+    //! This pass checks for uses of variables that may not have been assigned,
+    //!   by solving definite assignment on each function (see sem_dataflow.h),
     //!   and emit warnings.
-    void pass_unreachable_code(passman& pman, pr::ast_node* node);
+    bool pass_uninitialized_variables(passman& pman, pr::ast_node* node);
+    
+    //! Fold the constant arithmetic expressions into integer literals, and simplify
+    //!   the identities x + 0, x - 0, x * 1, x / 1 (giving x) and x * 0 (giving 0
+    //!   when x has no side effects).
+    //! Divisions by a constant zero are left for run time, with a warning.
+    //! It runs once the warning passes are done with each function.
+    bool pass_fold_constants(passman& pman, pr::ast_node* node);
+    
+    //! The passes below work on the whole program : they do nothing on other nodes.
+    
+    //! Evaluate at compile time the calls to pure functions whose arguments are
+    //!   all integer literals (see sem_eval.h), and replace them by their result.
+    bool pass_evaluate_calls(passman& pman, pr::ast_node* node);
+    
+    //! Lower the bodies of the functions to the IR of the semantic context
+    //!   (see sem_ir.h), replacing its previous contents.
+    bool pass_lower_ir(passman& pman, pr::ast_node* node);
+    
+    //! Convert the lowered functions to SSA form (see sem_ssa.h).
+    bool pass_build_ssa(passman& pman, pr::ast_node* node);
+    
+    //! Propagate the constants of the functions in SSA form (see sem_sccp.h).
+    bool pass_propagate_constants(passman& pman, pr::ast_node* node);
+    
+    //! Remove the redundant operations of the functions in SSA form (see sem_gvn.h).
+    bool pass_number_values(passman& pman, pr::ast_node* node);
+    
+    //! Remove the dead code of the functions in SSA form (see sem_dce.h).
+    bool pass_eliminate_dead_code(passman& pman, pr::ast_node* node);
+    
+    //! Inline the calls of the functions in SSA form, and simplify them again
+    //!   (see sem_inline.h).
+    bool pass_inline_calls(passman& pman, pr::ast_node* node);
+    
+    //! Lower the calls in tail position of the functions in SSA form, once they
+    //!   have been inlined (see sem_tail.h).
+    bool pass_lower_tail_calls(passman& pman, pr::ast_node* node);
 }
 
 #endif // NUT_SEM_PASSMAN_H
@@ -0,0 +1,65 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_PURITY_H
+#define NUT_SEM_PURITY_H
+
+#include "nut/pr_ast.h"
+#include "nut/sem_declarator.h"
+#include "nut/sem_callgraph.h"
+#include <iostream>
+
+//!
+//! sem_purity
+//!
+
+//! This module classifies functions as pure, read-only or effectful (see the
+//!   PURITY_* constants in sem_declarator.h).
+//! A function's own effects come from its body : reading a variable that is not
+//!   one of its variables makes it read-only, assigning one makes it effectful.
+//! They are then combined with the effects of the functions it calls, bottom-up
+//!   over the call graph, the functions of a recursive component sharing the
+//!   same purity. Functions imported from other modules come with their purity.
+//!
+//! Pure functions called with the same arguments always give the same result,
+//!   so their calls can be memoized or eliminated as common subexpressions.
+//! The language has neither global variables nor I/O builtins yet, so these are
+//!   the effects a body can have so far.
+
+namespace sem
+{
+    //! Get the effects of a function's own body (without its calls), from the
+    //!   uses of its variables and its calls.
+    //! Reading an identifier that is not a use of its variables (a non-local or
+    //!   unresolved one) makes it read-only, assigning it or making an unresolved
+    //!   call makes it effectful, so a body that was not analyzed is only
+    //!   considered pure if it refers to nothing.
+    int purity_body(function* fun, pr::ast_node* node);
+    
+    //! Compute the purity of all the functions of a call graph, bottom-up,
+    //!   using at most 'threads' threads.
+    void purity_analyze(call_graph& graph, int threads);
+    
+    //! Get the name of a purity constant.
+    char const* purity_name(int purity);
+    
+    //! Print the purity of each function, one per line, in program order.
+    void purity_dump(call_graph& graph, std::ostream& os);
+}
+
+#endif // NUT_SEM_PURITY_H
@@ -0,0 +1,214 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_QUERY_H
+#define NUT_SEM_QUERY_H
+
+#include "nut/pr_lexer.h"
+#include "nut/pr_parser.h"
+#include "nut/pr_context.h"
+#include "nut/pr_diagnostics.h"
+#include "nut/pr_ast.h"
+#include "nut/sem_context.h"
+#include "nut/sem_passman.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <iostream>
+
+//!
+//! sem_query
+//!
+
+//! This module implements the compiler as a set of memoized queries, for
+//!   long-lived processes (watch mode, editor servers) that recompile the
+//!   same files over and over.
+//!
+//! Each query (see sem_queries.inc) computes a value from other queries, and
+//!   records them as its dependencies. Its result is summarized by a fingerprint.
+//! When an input changes, the database revision is bumped. A query asked again
+//!   in a later revision first re-validates its dependencies : if none of their
+//!   fingerprints changed, its value is reused, otherwise it is recomputed. A
+//!   recomputed query whose fingerprint is the same does not invalidate its own
+//!   dependents, so editing a function body only re-analyzes that function.
+//!
+//! Function-local passes are ran by the BODY_TYPES query provider, on one function
+//!   at a time. Diagnostics are stored relatively to the function start so they
+//!   stay valid when the function moves in the file.
+//! Only the functions whose BODY_TYPES query ran in the current revision have
+//!   their AST nodes annotated (declarators and result types).
+//!
+//! The IR query analyzes its file again as a whole, in a separate program unit :
+//!   the whole-program passes (call evaluation, inlining) make the IR of each
+//!   function depend on the bodies of the others. It is still only recomputed
+//!   when the file (or an imported summary) changes.
+//!
+//! Imported summaries (see sem_summary.h) are inputs too : their text is read
+//!   through SOURCE queries, keyed by their file name.
+
+namespace sem
+{
+    //! Query kinds enumeration constants.
+    #define DECL_QUERY(id, name) QUERY_ ## id,
+    enum
+    {
+        #include "nut/sem_queries.inc"
+        
+        QUERY_COUNT
+    };
+    #undef DECL_QUERY
+    
+    //! A query key.
+    //!
+    //! kind: QUERY_* constant
+    //! file: the file the query is about
+    //! name: the function the query is about, if any
+    struct query_key
+    {
+        int kind;
+        std::string file;
+        std::string name;
+    };
+    
+    //! Keys ordering, for the query map.
+    bool operator<(query_key const& a, query_key const& b);
+    
+    //! A memoized query.
+    //!
+    //! fingerprint: hash summarizing the query's value
+    //! verified:    last revision in which the value was known to be up to date
+    //! changed:     last revision in which the fingerprint changed
+    //! deps:        the queries used to compute the value, in order
+    //! text:        the value, for SOURCE, SIGNATURE, BODY and IR queries
+    //! diags:       the value, for BODY_TYPES queries
+    //! failed:      true if the query stopped on an error
+    struct query
+    {
+        unsigned long long fingerprint;
+        int verified;
+        int changed;
+        std::vector<query_key> deps;
+        
+        std::string text;
+        std::vector<pr::diagnostic> diags;
+        bool failed;
+    };
+    
+    //! A parsed file and everything needed to analyze it.
+    //! It is the value of a PROGRAM query, and it is replaced when the
+    //!   file's source changes.
+    struct program_unit
+    {
+        program_unit(std::string const& source);
+        
+        std::istringstream in;
+        pr::context ctx;
+        context sctx;
+        pr::lexer lex;
+        pr::parser par;
+        passman pman;
+        
+        //! The AST, 0 if the file could not be parsed.
+        pr::ast_node* ast;
+    };
+    
+    //! Query statistics.
+    //!
+    //! executed: number of times a provider was ran
+    //! reused:   number of times a value was reused from a previous revision
+    struct query_stats
+    {
+        unsigned long executed;
+        unsigned long reused;
+    };
+    
+    //! Compilation options, applied to each program unit.
+    //! They must be set before the first query, changing them does not
+    //!   invalidate the memoized values.
+    //!
+    //! jobs:    maximum number of threads used by the passes (see passman)
+    //! roots:   root functions, only the functions they reach are analyzed
+    //! passes:  passes to enable (or disable), by name, in order
+    //! imports: files of the summaries of the modules the files depend on
+    struct query_options
+    {
+        int jobs;
+        std::vector<std::string> roots;
+        std::vector<std::pair<std::string, bool> > passes;
+        std::vector<std::string> imports;
+    };
+    
+    //! The query database.
+    //!
+    //! revision: the current revision, bumped when an input changes
+    //! options:  the compilation options
+    //! queries:  memoized queries
+    //! units:    the PROGRAM query values, by file
+    //! active:   the queries being computed (the innermost last)
+    struct query_db
+    {
+        int revision;
+        query_options options;
+        std::map<query_key, query> queries;
+        std::map<std::string, program_unit*> units;
+        std::vector<query_key> active;
+        
+        query_stats stats[QUERY_COUNT];
+    };
+    
+    //! Create an empty query database.
+    query_db query_db_create();
+    
+    //! Free a query database.
+    void query_db_free(query_db& db);
+    
+    //! Set the source text of a file.
+    //! The revision is bumped if it changed.
+    void query_set_source(query_db& db, std::string const& file, std::string const& source);
+    
+    //! Get the source text of a file.
+    std::string const& query_source(query_db& db, std::string const& file);
+    
+    //! Get a parsed file.
+    //! Throws if an imported summary is invalid, or on unknown pass or root names.
+    program_unit* query_program(query_db& db, std::string const& file);
+    
+    //! Get the type of a function, empty if there is no such function.
+    std::string const& query_signature(query_db& db, std::string const& file, std::string const& function);
+    
+    //! Get the source text of a function, empty if there is no such function.
+    std::string const& query_body(query_db& db, std::string const& file, std::string const& function);
+    
+    //! Get the function-local passes results for a function.
+    //! Diagnostics offsets are relative to the function start.
+    query const& query_body_types(query_db& db, std::string const& file, std::string const& function);
+    
+    //! Get the IR of a file once all the passes ran, empty if they failed.
+    //! Throws if an imported summary is invalid.
+    std::string const& query_ir(query_db& db, std::string const& file);
+    
+    //! Record all the diagnostics of a file in the given sink.
+    //! Only the functions reachable from the roots (if any) are analyzed.
+    void query_diagnostics(query_db& db, std::string const& file, pr::diag_sink& sink);
+    
+    //! Print the query statistics, one line per query kind.
+    void query_report(query_db& db, std::ostream& os);
+}
+
+#endif // NUT_SEM_QUERY_H
@@ -0,0 +1,65 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_SCCP_H
+#define NUT_SEM_SCCP_H
+
+#include "nut/sem_ir.h"
+
+//!
+//! sem_sccp
+//!
+
+//! This module implements sparse conditional constant propagation (Wegman and
+//!   Zadeck) on the IR functions in SSA form.
+//! Each register gets a lattice value (undefined, constant or varying), computed
+//!   from the blocks found executable so far : values flow along the def-use
+//!   chains, and blocks and edges become executable as jumps are reached.
+//! Arithmetic uses the same 32-bit wrapping semantics as the evaluator (see
+//!   sem_eval.h), divisions that would trap are left for run time.
+
+namespace sem
+{
+    //! Lattice states.
+    //!
+    //! TOP:      no value has been seen yet (undefined)
+    //! CONSTANT: the register always holds the same value
+    //! BOTTOM:   the register may hold different values (varying)
+    enum
+    {
+        SCCP_TOP,
+        SCCP_CONSTANT,
+        SCCP_BOTTOM
+    };
+    
+    //! A lattice value.
+    struct sccp_value
+    {
+        int state;
+        int value;
+    };
+    
+    //! Propagate the constants of a function in SSA form.
+    //! Uses of constant registers are replaced by constants, and their definitions
+    //!   removed, as well as the blocks found unreachable (and the phi values coming
+    //!   from them).
+    //! Returns the number of registers found constant.
+    int sccp_run(ir_program& ir, int fun);
+}
+
+#endif // NUT_SEM_SCCP_H
@@ -0,0 +1,63 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_SSA_H
+#define NUT_SEM_SSA_H
+
+#include "nut/sem_ir.h"
+#include <vector>
+
+//!
+//! sem_ssa
+//!
+
+//! This module converts the IR functions from stack form to SSA form (see sem_ir.h).
+//! Variables can't escape in nut, so they are all promoted to registers : each
+//!   use of a variable is replaced by its reaching value, and phis are placed at
+//!   the dominance frontiers of its assignments, where it is live.
+//! The operand stack is replaced by registers too, as it is empty between
+//!   statements.
+
+namespace sem
+{
+    //! The dominator tree of an IR control-flow graph.
+    //!
+    //! idom:     the immediate dominator of each block (the entry block is its own
+    //!           immediate dominator, unreachable blocks have -1)
+    //! children: the blocks immediately dominated by each block
+    //! frontier: the dominance frontier of each block
+    struct dominators
+    {
+        std::vector<int> idom;
+        std::vector<std::vector<int> > children;
+        std::vector<std::vector<int> > frontier;
+    };
+    
+    //! Compute the dominator tree of an IR control-flow graph, and its dominance frontiers.
+    dominators dominators_create(ir_graph& graph);
+    
+    //! Free a dominator tree.
+    void dominators_free(dominators& dom);
+    
+    //! Convert a lowered function to SSA form, unless it already is.
+    //! Its unreachable blocks are dropped.
+    //! Throws if its stack form is ill-formed (internal error).
+    void ssa_construct(ir_program& ir, int fun);
+}
+
+#endif // NUT_SEM_SSA_H
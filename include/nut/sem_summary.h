@@ -0,0 +1,123 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_SUMMARY_H
+#define NUT_SEM_SUMMARY_H
+
+#include "nut/sem_ir.h"
+#include "nut/sem_callgraph.h"
+#include "nut/pr_scope.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+
+//!
+//! sem_summary
+//!
+
+//! This module handles module summaries, which let a compilation use the functions
+//!   of other modules (its dependencies) without their sources.
+//! A summary holds the signature and the purity of each function of a module, and
+//!   the IR body (in SSA form) of the ones small enough to be inlined (see
+//!   sem_inline.h), so calls to them can be inlined and their constants propagated
+//!   across the module boundary.
+//!
+//! Summaries are stored as text, one function per line followed by its body pieces,
+//!   one per line :
+//!
+//!   nut-summary 1
+//!   function <name> <purity> <return type> <argument count> <argument types...>
+//!            <registers> <piece count>
+//!   <tag> <op> <target count> (<target tag> <target value>)*
+//!
+//! Function targets are indices in the summary's functions. Bodies only call the
+//!   functions of their own module, so a summary is enough to import them.
+
+namespace sem
+{
+    //! Forward declaration.
+    struct context;
+    
+    //! A function of a summary.
+    //!
+    //! name:      the function's name
+    //! purity:    its purity (see PURITY_* constants)
+    //! ret_tp:    the name of its return type
+    //! args_tp:   the names of its argument types
+    //! registers: the number of registers of its body
+    //! body:      its body in SSA form (empty if it is not inlinable)
+    //! decl:      its declarator, once declared in a semantic context
+    struct summary_function
+    {
+        std::string name;
+        int purity;
+        std::string ret_tp;
+        std::vector<std::string> args_tp;
+        int registers;
+        std::vector<piece> body;
+        function* decl;
+    };
+    
+    //! A summary, of a module or of all the dependencies of a compilation.
+    //!
+    //! functions: the functions, in module order
+    //! index:     the indices of the declared functions, by name
+    struct summary
+    {
+        std::vector<summary_function> functions;
+        std::map<std::string, int> index;
+    };
+    
+    //! Create the summary of the functions of a program's IR once optimized, from
+    //!   the program's call graph (recursive functions are never inlined).
+    summary summary_create(ir_program& ir, call_graph& graph);
+    
+    //! Free a summary.
+    void summary_free(summary& sum);
+    
+    //! Write a summary.
+    void summary_write(summary const& sum, std::ostream& os);
+    
+    //! Read a summary, appending its functions to 'sum'.
+    //! Returns false if it is ill-formed ('sum' is then left unchanged).
+    bool summary_read(summary& sum, std::istream& is);
+    
+    //! Declare the functions of a summary in a semantic context, creating their
+    //!   declarators.
+    //! Returns false if a function is declared twice or uses an unknown type (the
+    //!   remaining functions are not declared).
+    bool summary_declare(summary& sum, context& ctx);
+    
+    //! Get the declared functions of a summary.
+    std::vector<function*> summary_functions(summary& sum);
+    
+    //! Add the declared functions of a summary to a parser scope, so that calls
+    //!   to them are parsed.
+    void summary_add_symbols(summary& sum, pr::scope& scp);
+    
+    //! Find a declared function of a summary by name.
+    //! Returns 0 if not found.
+    function* summary_find(summary& sum, std::string const& name);
+    
+    //! Add the declared functions of a summary to a program's IR (once created by
+    //!   ir_create), with their bodies, and resolve the calls to them.
+    void summary_import(summary& sum, ir_program& ir);
+}
+
+#endif // NUT_SEM_SUMMARY_H
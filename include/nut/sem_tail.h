@@ -0,0 +1,47 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_TAIL_H
+#define NUT_SEM_TAIL_H
+
+#include "nut/sem_ir.h"
+
+//!
+//! sem_tail
+//!
+
+//! This module lowers the calls in tail position of the IR functions in SSA form,
+//!   that is the calls whose result is returned right away : their block sets
+//!   the result as the returned value, then jumps to a block that only returns.
+//! It runs once the calls have been inlined (see sem_inline.h), so the other
+//!   optimizations see tail calls as plain calls.
+//!
+//! A call to another function is replaced by OP_TAIL_CALL, which ends the block
+//!   (the returning block being removed if nothing jumps there anymore).
+//! A call to the function itself jumps back to its entry block instead, so that
+//!   self-recursion becomes a loop : a new entry block is inserted before it, and
+//!   the arguments get phis there, from the entry and from each recursive call.
+
+namespace sem
+{
+    //! Lower the calls in tail position of a function in SSA form.
+    //! Returns the number of lowered calls.
+    int tail_run(ir_program& ir, int fun);
+}
+
+#endif // NUT_SEM_TAIL_H
@@ -0,0 +1,86 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_TYPES_H
+#define NUT_SEM_TYPES_H
+
+#include "nut/sem_declarator.h"
+#include <string>
+#include <vector>
+#include <map>
+
+//!
+//! sem_types
+//!
+
+//! This module defines the type table, that holds the canonical type declarators
+//!   of a compilation.
+//! Each distinct type is created once and only once in the table, therefore two
+//!   types are equal if and only if their pointers (or identifiers) are.
+//! Built-in types (see sem_builtins.inc) are created with the table, derived types
+//!   (arrays and functions) are interned on request.
+
+namespace sem
+{
+    //! Built-in types enumeration constants.
+    //! They are also the built-in types identifiers in any type table.
+    #define DECL_BUILTIN_TYPE(name, flags) BUILTIN_TYPE_ ## name,
+    enum
+    {
+        #include "nut/sem_builtins.inc"
+        
+        BUILTIN_TYPE_COUNT
+    };
+    #undef DECL_BUILTIN_TYPE
+    
+    //! The type table structure.
+    //!
+    //! types:   all the types of the table, indexed by identifier
+    //! names:   the built-in types, by name
+    //! derived: the derived types, by structural key (see sem_types.cpp)
+    struct type_table
+    {
+        std::vector<type*> types;
+        std::map<std::string, type*> names;
+        std::map<std::vector<int>, type*> derived;
+    };
+    
+    //! Create a type table, containing the built-in types.
+    type_table type_table_create();
+    
+    //! Delete a type table, and all its types.
+    void type_table_free(type_table& table);
+    
+    //! Get a built-in type from its BUILTIN_TYPE_* identifier.
+    inline type* type_table_builtin(type_table& table, int id)
+    {
+        return table.types[id];
+    }
+    
+    //! Find a built-in type by name.
+    //! Returns 0 if not found.
+    type* type_table_find(type_table& table, std::string const& name);
+    
+    //! Get the canonical array type of 'length' elements of type 'element'.
+    type* type_table_array(type_table& table, type* element, int length);
+    
+    //! Get the canonical function type returning 'ret', with the given argument types.
+    type* type_table_function(type_table& table, type* ret, std::vector<type*> const& arguments);
+}
+
+#endif // NUT_SEM_TYPES_H
@@ -0,0 +1,66 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUT_SEM_WORKERS_H
+#define NUT_SEM_WORKERS_H
+
+#include <functional>
+
+//!
+//! sem_workers
+//!
+
+//! This module implements a small work-stealing task runner, used to run
+//!   independent semantic work (for example passes on different functions) concurrently.
+//! Each worker thread owns a queue of task indices, that it consumes from the back.
+//! A worker whose queue is empty steals tasks from the front of the other queues,
+//!   so that unbalanced tasks (functions of very different sizes) keep all the
+//!   threads busy.
+//! Worker threads can be kept in a pool between runs, so that running many
+//!   small task sets (for example a traversal of each function per pass set)
+//!   doesn't create and join threads each time.
+
+namespace sem
+{
+    //! Get the default number of worker threads (the number of hardware threads).
+    int workers_default_count();
+    
+    //! Run task(0), ..., task(count-1) on at most 'threads' worker threads, and wait
+    //!   for all of them to complete.
+    //! The calling thread is used as one of the workers.
+    //! Tasks are not ran in any particular order, so they must be independent.
+    //! If some tasks throw, the exception of the first one (by index) is rethrown
+    //!   once all the tasks are done.
+    void workers_run(int threads, int count, std::function<void(int)> const& task);
+    
+    //! A pool of worker threads, waiting for tasks between runs.
+    struct worker_pool;
+    
+    //! Create a pool for runs on at most 'threads' worker threads (the calling
+    //!   thread being one of them).
+    worker_pool* workers_create(int threads);
+    
+    //! Stop the threads of a pool, and free it.
+    void workers_free(worker_pool* pool);
+    
+    //! Same as workers_run, using the threads of a pool (at most 'threads' of them).
+    //! A pool runs a single task set at a time.
+    void workers_run(worker_pool& pool, int threads, int count, std::function<void(int)> const& task);
+}
+
+#endif // NUT_SEM_WORKERS_H
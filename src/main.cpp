@@ -20,41 +20,319 @@
 #include "nut/pr_context.h"
 #include "nut/pr_parser.h"
 #include "nut/pr_ast.h"
+#include "nut/sem_context.h"
 #include "nut/sem_passman.h"
+#include "nut/sem_workers.h"
+#include "nut/sem_query.h"
+#include "nut/sem_callgraph.h"
+#include "nut/sem_cfg.h"
+#include "nut/sem_purity.h"
+#include "nut/sem_summary.h"
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <vector>
+#include <cstdlib>
+#include <thread>
+#include <chrono>
 
-#include <map>
+//! Command line options.
+//!
+//! input:       the source file to compile
+//! time_report: print the time spent in each compilation phase
+//! jobs:        number of threads used by the semantic analyzer
+//! passes:      passes to enable (or disable), in command line order
+//! diag_format: diagnostics rendering format (pr::DIAG_FORMAT_* constants)
+//! max_diags:   maximum number of rendered diagnostics (0 for no limit)
+//! roots:       root functions, only the functions they reach are analyzed
+//! imports:     summaries of the modules the input depends on
+//! summary:     file to write the input's summary to (none if empty)
+//! watch:       recompile the input each time it changes, reusing unchanged results
+//! dump_calls:  print the call graph components, in bottom-up order
+//! dump_cfg:    print the control-flow graph of each function
+//! dump_purity: print the purity of each function
+//! dump_ir:     print the IR of each function
+struct options
+{
+    std::string input;
+    bool time_report;
+    int jobs;
+    std::vector<std::pair<std::string, bool> > passes;
+    int diag_format;
+    int max_diags;
+    std::vector<std::string> roots;
+    std::vector<std::string> imports;
+    std::string summary;
+    bool watch;
+    bool dump_calls;
+    bool dump_cfg;
+    bool dump_purity;
+    bool dump_ir;
+};
+
+//! Parse the command line options.
+//! Throws on invalid usage.
+static options parse_options(int argc, char** argv)
+{
+    options opts;
+    opts.input = "scratch/test.nut";
+    opts.time_report = false;
+    opts.jobs = sem::workers_default_count();
+    opts.diag_format = pr::DIAG_FORMAT_TEXT;
+    opts.max_diags = 0;
+    opts.watch = false;
+    opts.dump_calls = false;
+    opts.dump_cfg = false;
+    opts.dump_purity = false;
+    opts.dump_ir = false;
+    
+    std::string const enable = "-fenable-pass=";
+    std::string const disable = "-fdisable-pass=";
+    std::string const format = "-fdiagnostics-format=";
+    std::string const max_diags = "-fmax-diagnostics=";
+    std::string const root = "-froot=";
+    std::string const import = "-fimport=";
+    std::string const summary = "-femit-summary=";
+    
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        
+        if (arg == "-ftime-report")
+            opts.time_report = true;
+        else if (arg == "-fwatch")
+            opts.watch = true;
+        else if (arg == "-fdump-callgraph")
+            opts.dump_calls = true;
+        else if (arg == "-fdump-cfg")
+            opts.dump_cfg = true;
+        else if (arg == "-fdump-purity")
+            opts.dump_purity = true;
+        else if (arg == "-fdump-ir")
+            opts.dump_ir = true;
+        else if (!arg.compare(0, 2, "-j"))
+        {
+            std::string count = arg.substr(2);
+            if (!count.size() && i + 1 < argc)
+                count = argv[++i];
+            
+            opts.jobs = std::atoi(count.c_str());
+            if (opts.jobs < 1)
+                throw std::logic_error("invalid job count '" + count + "'");
+        }
+        else if (!arg.compare(0, enable.size(), enable))
+            opts.passes.push_back(std::make_pair(arg.substr(enable.size()), true));
+        else if (!arg.compare(0, disable.size(), disable))
+            opts.passes.push_back(std::make_pair(arg.substr(disable.size()), false));
+        else if (arg == format + "text")
+            opts.diag_format = pr::DIAG_FORMAT_TEXT;
+        else if (arg == format + "json")
+            opts.diag_format = pr::DIAG_FORMAT_JSON;
+        else if (!arg.compare(0, max_diags.size(), max_diags))
+        {
+            std::string count = arg.substr(max_diags.size());
+            
+            opts.max_diags = std::atoi(count.c_str());
+            if (opts.max_diags < 0 || (!opts.max_diags && count != "0"))
+                throw std::logic_error("invalid diagnostics count '" + count + "'");
+        }
+        else if (!arg.compare(0, root.size(), root))
+            opts.roots.push_back(arg.substr(root.size()));
+        else if (!arg.compare(0, import.size(), import))
+            opts.imports.push_back(arg.substr(import.size()));
+        else if (!arg.compare(0, summary.size(), summary))
+            opts.summary = arg.substr(summary.size());
+        else if (arg.size() && arg[0] == '-')
+            throw std::logic_error("unknown option '" + arg + "'");
+        else
+            opts.input = arg;
+    }
+    
+    return opts;
+}
+
+//! Read a whole file.
+static std::string read_file(std::string const& path)
+{
+    std::ifstream fs(path);
+    std::ostringstream ss;
+    ss << fs.rdbuf();
+    return ss.str();
+}
 
-int main()
+//! Load the summaries of the modules the input depends on, and declare their
+//!   functions to the parser and the semantic analyzer.
+//! Throws if a summary can't be read or declared.
+static void import_summaries(options const& opts, pr::context& ctx, sem::context& sctx)
+{
+    for (unsigned int i = 0; i < opts.imports.size(); ++i)
+    {
+        std::ifstream fs(opts.imports[i]);
+        if (!fs || !sem::summary_read(sctx.imports, fs))
+            throw std::logic_error("invalid summary '" + opts.imports[i] + "'");
+    }
+    
+    if (!sem::summary_declare(sctx.imports, sctx))
+        throw std::logic_error("conflicting or invalid imported functions");
+    
+    sem::summary_add_symbols(sctx.imports, ctx.scp);
+}
+
+//! Watch the input file (and the imported summaries), printing its diagnostics,
+//!   and its IR if asked to, each time it changes.
+//! Compilation goes through the query database, so only the functions
+//!   affected by a change are analyzed again.
+//! The query statistics are printed instead of the time report.
+//! Throws if an option is not supported in watch mode.
+static void watch(options const& opts)
+{
+    if (opts.dump_calls || opts.dump_cfg || opts.dump_purity || opts.summary.size())
+        throw std::logic_error("-fdump-callgraph, -fdump-cfg, -fdump-purity and -femit-summary are not supported with -fwatch");
+    
+    sem::query_db db = sem::query_db_create();
+    db.options.jobs = opts.jobs;
+    db.options.roots = opts.roots;
+    db.options.passes = opts.passes;
+    db.options.imports = opts.imports;
+    
+    int revision = -1;
+    
+    for (;;)
+    {
+        std::string source = read_file(opts.input);
+        sem::query_set_source(db, opts.input, source);
+        
+        for (unsigned int i = 0; i < opts.imports.size(); ++i)
+            sem::query_set_source(db, opts.imports[i], read_file(opts.imports[i]));
+        
+        if (db.revision != revision)
+        {
+            pr::diag_sink sink = pr::diag_sink_create();
+            sink.format = opts.diag_format;
+            sink.max_count = opts.max_diags;
+            
+            sem::query_diagnostics(db, opts.input, sink);
+            pr::diag_render(sink, source, std::cerr);
+            
+            if (opts.dump_ir)
+                std::cout << sem::query_ir(db, opts.input) << std::flush;
+            
+            if (opts.time_report)
+                sem::query_report(db, std::cerr);
+            
+            revision = db.revision;
+        }
+        
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+}
+
+int main(int argc, char** argv)
 {
     using namespace pr;
     using namespace sem;
     
     try
     {
-        std::ifstream fs("scratch/test.nut");
+        options opts = parse_options(argc, argv);
+        
+        if (opts.watch)
+            watch(opts);
+        
+        std::ifstream fs(opts.input);
         
-        context ctx = context_create();
+        pr::context ctx = pr::context_create();
+        sem::context sctx = sem::context_create();
         lexer lex = lexer_create(fs, ctx);
         parser par = parser_create(lex, ctx);
-        passman pman = passman_create(par);
+        passman pman = passman_create(par, sctx);
         
+        import_summaries(opts, ctx, sctx);
+        
+        for (unsigned int i = 0; i < opts.passes.size(); ++i)
+        {
+            int id = passman_find_pass(pman, opts.passes[i].first);
+            if (id < 0)
+                throw std::logic_error("unknown pass '" + opts.passes[i].first + "'");
+            
+            passman_enable_pass(pman, id, opts.passes[i].second);
+        }
+        
+        // Tell which enabled passes won't run because a pass they require doesn't
+        unsigned int skipped = passman_skipped_passes(pman);
+        for (unsigned int i = 0; i < pman.passes.size(); ++i)
+            if (pman.passes[i].enabled && (skipped & PASS_MASK(i)))
+                std::cerr << "note: pass '" << pman.passes[i].name << "' skipped, it requires a disabled pass" << std::endl;
+        
+        lex.timing = opts.time_report;
+        pman.timing = opts.time_report;
+        pman.jobs = opts.jobs;
+        pman.roots = opts.roots;
+        ctx.diags.format = opts.diag_format;
+        ctx.diags.max_count = opts.max_diags;
+        
+        // Errors are recorded in the context's sink, and
+        //   rendered along with the warnings below
         ast_node* ast = parser_parse_program(par);
+        bool failed = !ast || !passman_run_all(pman, ast);
+        
+        if (ctx.diags.diags.size() || ctx.diags.format == DIAG_FORMAT_JSON)
+            diag_render(ctx.diags, lexer_getsource(lex), std::cerr);
         
-        passman_run_all(pman, ast);
+        if (opts.time_report && !failed)
+            passman_time_report(pman, std::cerr);
         
-        ast_pretty_print(ast);
+        if (opts.summary.size() && !failed)
+        {
+            std::ofstream os(opts.summary);
+            call_graph graph = call_graph_create(ast, summary_functions(sctx.imports));
+            summary sum = summary_create(sctx.ir, graph);
+            
+            summary_write(sum, os);
+            
+            summary_free(sum);
+            call_graph_free(graph);
+        }
         
-        ast_free(ast);
+        if (opts.dump_calls && !failed)
+        {
+            call_graph graph = call_graph_create(ast, summary_functions(sctx.imports));
+            call_graph_dump(graph, std::cout);
+            call_graph_free(graph);
+        }
+        
+        if (opts.dump_purity && !failed)
+        {
+            call_graph graph = call_graph_create(ast, summary_functions(sctx.imports));
+            purity_analyze(graph, opts.jobs);
+            purity_dump(graph, std::cout);
+            call_graph_free(graph);
+        }
+        
+        for (unsigned int i = 0; opts.dump_cfg && !failed && i < ast->children.size(); ++i)
+        {
+            cfg graph = cfg_create(ast->children[i]);
+            std::cout << ast->children[i]->as_function_decl->name << ":" << std::endl;
+            cfg_dump(graph, std::cout);
+            cfg_free(graph);
+        }
+        
+        if (opts.dump_ir && !failed)
+            ir_dump(sctx.ir, std::cout);
+        
+        if (!failed)
+            ast_pretty_print(ast);
         
         passman_free(pman);
         parser_free(par);
         lexer_free(lex);
-        context_free(ctx);
+        sem::context_free(sctx);
+        pr::context_free(ctx);
+        
+        if (failed)
+            return -1;
     }
     catch (std::exception const& exc)
     {
@@ -17,12 +17,15 @@
  */
 
 #include "nut/pr_ast.h"
+#include <algorithm>
+#include <cstring>
 
 namespace pr
 {
-    ast_node::ast_node(token const& tok)
+    ast_node::ast_node(ast_arena& arena, ast_token const& tok) :
+        saved_tok(tok),
+        children(ast_allocator<ast_node*>(&arena))
     {
-        saved_tok = tok;
         self = this;
         
         parent = prev = next = 0;
@@ -30,9 +33,6 @@ namespace pr
         res_tp = 0;
     }
     
-    ast_node::~ast_node()
-    { }
-    
     //! Associates a node tag value to a name string.
     struct named_node
     {
@@ -80,6 +80,49 @@ namespace pr
     /*** Public module API ***/
     /*************************/
     
+    ast_arena ast_arena_create()
+    {
+        ast_arena arena;
+        arena.used = 0;
+        arena.capacity = 0;
+        return arena;
+    }
+    
+    void* ast_arena_alloc(ast_arena& arena, int size)
+    {
+        // Keep every allocation aligned for any node member
+        int align = alignof(std::max_align_t);
+        size = (size + align - 1) / align * align;
+        
+        if (arena.used + size > arena.capacity)
+        {
+            arena.capacity = std::max(AST_ARENA_SLAB_SIZE, size);
+            arena.slabs.push_back(static_cast<char*>(::operator new(arena.capacity)));
+            arena.used = 0;
+        }
+        
+        void* mem = arena.slabs.back() + arena.used;
+        arena.used += size;
+        return mem;
+    }
+    
+    char const* ast_arena_string(ast_arena& arena, std::string const& str)
+    {
+        char* copy = static_cast<char*>(ast_arena_alloc(arena, str.size() + 1));
+        std::memcpy(copy, str.c_str(), str.size() + 1);
+        return copy;
+    }
+    
+    void ast_arena_free(ast_arena& arena)
+    {
+        for (unsigned int i = 0; i < arena.slabs.size(); ++i)
+            ::operator delete(arena.slabs[i]);
+        
+        arena.slabs.clear();
+        arena.used = 0;
+        arena.capacity = 0;
+    }
+    
     void ast_node_pretty_print(ast_node* node, std::ostream& os)
     {
         named_node* name = ast_find_named_node(node->tag);
@@ -95,19 +138,61 @@ namespace pr
         ast_pretty_print_indented(root, os, 0);
     }
     
-    void ast_free(ast_node* root)
+    void ast_add_child(ast_node* node, ast_node* child)
     {
-        for (unsigned int i = 0; i < root->children.size(); ++i)
-            ast_free(root->children[i]);
+        if (child)
+            node->children.push_back(child);
+    }
+    
+    void ast_replace(ast_node* node, ast_node* by)
+    {
+        by->parent = node->parent;
+        by->prev = node->prev;
+        by->next = node->next;
         
-        if (root->decl)
-            declarator_free(root->decl);
+        if (node->prev)
+            node->prev->next = by;
+        if (node->next)
+            node->next->prev = by;
         
-        delete root;
+        if (node->parent)
+        {
+            ast_node_list& siblings = node->parent->children;
+            std::replace(siblings.begin(), siblings.end(), node, by);
+        }
+        
+        node->parent = node->prev = node->next = 0;
     }
     
-    void ast_add_child(ast_node* node, ast_node* child)
+    std::string ast_callee_name(ast_node* call)
+    {
+        ast_node* id = call->children[0];
+        return id->tag == IDENTIFIER_EXPR ? id->as_identifier_expr->name : "";
+    }
+    
+    void ast_call_arguments(ast_node* call, std::vector<ast_node*>& args)
+    {
+        args.clear();
+        if (call->children.size() < 2)
+            return;
+        
+        ast_node* lst = call->children[1];
+        while (lst->tag == LIST_EXPR)
+        {
+            args.push_back(lst->children[1]);
+            lst = lst->children[0];
+        }
+        args.push_back(lst);
+        
+        std::reverse(args.begin(), args.end());
+    }
+    
+    void ast_collect_calls(ast_node* root, std::vector<ast_node*>& calls)
     {
-        node->children.push_back(child);
+        if (root->tag == FUNCTION_CALL_EXPR)
+            calls.push_back(root);
+        
+        for (unsigned int i = 0; i < root->children.size(); ++i)
+            ast_collect_calls(root->children[i], calls);
     }
 }
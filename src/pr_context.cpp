@@ -44,6 +44,8 @@ namespace pr
     {
         context ctx;
         ctx.scp = scope_create();
+        ctx.diags = diag_sink_create();
+        ctx.arena = ast_arena_create();
         
         context_expose_builtins(ctx);
         
@@ -53,5 +55,7 @@ namespace pr
     void context_free(context& ctx)
     {
         scope_free(ctx.scp);
+        diag_sink_free(ctx.diags);
+        ast_arena_free(ctx.arena);
     }
 }
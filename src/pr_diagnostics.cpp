@@ -0,0 +1,263 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/pr_diagnostics.h"
+#include <sstream>
+#include <algorithm>
+
+namespace pr
+{
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! A diagnostic message description.
+    struct diag_info
+    {
+        int id;
+        int kind;
+        std::string name;
+        std::string format;
+    };
+    
+    #define DECL_DIAG(id, kind, format) { DIAG_ ## id, kind, #id, format },
+    
+    static diag_info diag_infos[] =
+    {
+        #include "nut/pr_diagnostics.inc"
+    };
+    
+    #undef DECL_DIAG
+    
+    //! Rendering prefixes, indexed by kind.
+    static std::string const diag_prefixes[] =
+    {
+        "parse error",
+        "semantic error",
+        "warning"
+    };
+    
+    //! Compare diagnostics by location only (for a stable sort).
+    static bool diag_less(diagnostic const& a, diagnostic const& b)
+    {
+        return a.offset < b.offset;
+    }
+    
+    //! Check if two diagnostics are the same.
+    static bool diag_equal(diagnostic const& a, diagnostic const& b)
+    {
+        if (a.id != b.id || a.offset != b.offset)
+            return false;
+        
+        for (int i = 0; i < DIAG_MAX_ARGS; ++i)
+            if (a.args[i] != b.args[i])
+                return false;
+        
+        return true;
+    }
+    
+    //! Escape a string for JSON output.
+    static std::string json_escape(std::string const& str)
+    {
+        std::string out;
+        
+        for (unsigned int i = 0; i < str.size(); ++i)
+        {
+            char ch = str[i];
+            
+            if (ch == '"' || ch == '\\')
+                out += '\\';
+            
+            if (ch == '\t')
+                out += "\\t";
+            else if ((unsigned char) ch < 0x20)
+                out += ' ';
+            else
+                out += ch;
+        }
+        
+        return out;
+    }
+    
+    //! Render a single diagnostic for humans, in the format :
+    //! kind: line %line, col %column: message
+    //! abababababababababab
+    //! ~~~~~~~~~~~~~^~~~
+    static void diag_render_text(diagnostic const& diag, std::string const& source,
+                                 int line, int line_start, std::ostream& os)
+    {
+        int column = diag.offset - line_start + 1;
+        
+        os << diag_prefixes[diag_kind(diag.id)] << ": ";
+        os << "line " << line << ", col " << column << ": ";
+        os << diag_message(diag) << std::endl;
+        
+        std::string::size_type end = source.find('\n', line_start);
+        if (end == std::string::npos)
+            end = source.size();
+        os << source.substr(line_start, end - line_start) << std::endl;
+        
+        for (int i = 0; i < column-1; ++i) os << " ";
+        os << "^";
+        for (int i = 0; i < diag.length-1; ++i) os << "~";
+        os << std::endl;
+    }
+    
+    //! Render a single diagnostic as a JSON object.
+    static void diag_render_json(diagnostic const& diag, int line, int line_start, std::ostream& os)
+    {
+        os << "{\"kind\": \"" << diag_prefixes[diag_kind(diag.id)] << "\", ";
+        os << "\"id\": \"" << diag_infos[diag.id].name << "\", ";
+        os << "\"line\": " << line << ", ";
+        os << "\"column\": " << diag.offset - line_start + 1 << ", ";
+        os << "\"offset\": " << diag.offset << ", ";
+        os << "\"length\": " << diag.length << ", ";
+        os << "\"message\": \"" << json_escape(diag_message(diag)) << "\"}";
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    diag_sink diag_sink_create()
+    {
+        diag_sink sink;
+        sink.errors = 0;
+        sink.format = DIAG_FORMAT_TEXT;
+        sink.max_count = 0;
+        return sink;
+    }
+    
+    void diag_sink_free(diag_sink& sink)
+    {
+        sink.diags.clear();
+    }
+    
+    diagnostic diag_make(int id, token const& tok,
+                         std::string const& arg0,
+                         std::string const& arg1,
+                         std::string const& arg2)
+    {
+        return diag_make(id, tok.info.offset, tok.value.size(), arg0, arg1, arg2);
+    }
+    
+    diagnostic diag_make(int id, int offset, int length,
+                         std::string const& arg0,
+                         std::string const& arg1,
+                         std::string const& arg2)
+    {
+        diagnostic diag;
+        diag.id = id;
+        diag.offset = offset;
+        diag.length = length;
+        diag.args[0] = arg0;
+        diag.args[1] = arg1;
+        diag.args[2] = arg2;
+        return diag;
+    }
+    
+    int diag_kind(int id)
+    {
+        return diag_infos[id].kind;
+    }
+    
+    bool diag_is_error(diagnostic const& diag)
+    {
+        return diag_kind(diag.id) != DIAG_KIND_WARNING;
+    }
+    
+    void diag_emit(diag_sink& sink, diagnostic const& diag)
+    {
+        sink.diags.push_back(diag);
+        
+        if (diag_is_error(diag))
+            ++sink.errors;
+    }
+    
+    std::string diag_message(diagnostic const& diag)
+    {
+        std::string const& format = diag_infos[diag.id].format;
+        std::string msg;
+        
+        for (unsigned int i = 0; i < format.size(); ++i)
+        {
+            int arg = i+1 < format.size() ? format[i+1] - '0' : -1;
+            
+            if (format[i] == '%' && arg >= 0 && arg < DIAG_MAX_ARGS)
+            {
+                msg += diag.args[arg];
+                ++i;
+            }
+            else
+                msg += format[i];
+        }
+        
+        return msg;
+    }
+    
+    void diag_render(diag_sink& sink, std::string const& source, std::ostream& os)
+    {
+        std::vector<diagnostic>& diags = sink.diags;
+        
+        // Sort by location, then remove duplicates
+        std::stable_sort(diags.begin(), diags.end(), diag_less);
+        diags.erase(std::unique(diags.begin(), diags.end(), diag_equal), diags.end());
+        
+        int count = diags.size();
+        if (sink.max_count > 0 && count > sink.max_count)
+            count = sink.max_count;
+        
+        // Render everything in a buffer, locating lines in a single
+        //   forward scan of the source as diagnostics are sorted
+        std::ostringstream ss;
+        int line = 1;
+        int line_start = 0;
+        
+        if (sink.format == DIAG_FORMAT_JSON)
+            ss << "[";
+        
+        for (int i = 0; i < count; ++i)
+        {
+            diagnostic const& diag = diags[i];
+            
+            for (int at = line_start; at < diag.offset && at < (int) source.size(); ++at)
+            {
+                if (source[at] == '\n')
+                {
+                    ++line;
+                    line_start = at+1;
+                }
+            }
+            
+            if (sink.format == DIAG_FORMAT_JSON)
+            {
+                ss << (i ? ",\n " : "");
+                diag_render_json(diag, line, line_start, ss);
+            }
+            else
+                diag_render_text(diag, source, line, line_start, ss);
+        }
+        
+        if (sink.format == DIAG_FORMAT_JSON)
+            ss << "]" << std::endl;
+        else if (count < (int) diags.size())
+            ss << "note: " << diags.size() - count << " more diagnostics not shown" << std::endl;
+        
+        os << ss.str();
+    }
+}
@@ -19,6 +19,8 @@
 #include "nut/pr_lexer.h"
 #include "nut/pr_symbol.h"
 #include <cctype> // std::isdigit & cie
+#include <chrono>
+#include <sstream>
 
 namespace pr
 {   
@@ -88,28 +90,33 @@ namespace pr
     #undef DECL_TOKEN_CHAR
     #undef DECL_TOKEN
     
-    //! Returns whether or not the character is present in the operators alphabet.
-    //! The alphabet is built the first time this function is called.
-    static bool is_char_in_op_alphabet(int ch)
+    //! Build the operators alphabet, containing (uniquely)
+    //!   all characters present in the OP tokens.
+    static std::string op_tokens_alphabet()
     {
-        static std::string alphabet = "";
+        std::string alphabet;
         
-        // The first time, build the alphabet, containing (uniquely)
-        //   all characters present in the OP tokens.
-        // std::string::find returns std::string::npos if not found.
-        if (!alphabet.size())
+        for (int i = 0; i < op_tokens_size; ++i)
         {
-            for (int i = 0; i < op_tokens_size; ++i)
-            {
-                op_token& op = op_tokens[i];
-                
-                for (unsigned int j = 0; j < op.name.size(); ++j)
-                    if (alphabet.find(op.name[j]) == std::string::npos)
-                        alphabet += op.name[j];
-            }
+            op_token& op = op_tokens[i];
+            
+            for (unsigned int j = 0; j < op.name.size(); ++j)
+                if (alphabet.find(op.name[j]) == std::string::npos)
+                    alphabet += op.name[j];
         }
         
-        return alphabet.find(ch) != std::string::npos;
+        return alphabet;
+    }
+    
+    //! The operators alphabet is built once, before any lexer runs, and never
+    //!   modified afterwards, so lexers can run concurrently.
+    static std::string const op_alphabet = op_tokens_alphabet();
+    
+    //! Returns whether or not the character is present in the operators alphabet.
+    //! std::string::find returns std::string::npos if not found.
+    static bool is_char_in_op_alphabet(int ch)
+    {
+        return op_alphabet.find(ch) != std::string::npos;
     }
     
     //! Find an operator by name.
@@ -176,6 +183,7 @@ namespace pr
     {
         lex.current_info.line = 1;
         lex.current_info.column = 0;
+        lex.current_info.offset = -1;
         
         // Get first char from the stream
         lex.next_char = 0;
@@ -198,6 +206,7 @@ namespace pr
             lex.current_info.column = 0;
         }
         ++lex.current_info.column;
+        ++lex.current_info.offset;
         
         return ch;
     }
@@ -445,7 +454,17 @@ namespace pr
     token lexer_get(lexer& lex)
     {
         token tok = lex.next_token;
-        lex.next_token = lexer_get_token(lex);
+        
+        if (lex.timing)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            lex.next_token = lexer_get_token(lex);
+            lex.time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        else
+            lex.next_token = lexer_get_token(lex);
+        
+        ++lex.tokens;
         return tok;
     }
     
@@ -466,4 +485,21 @@ namespace pr
         
         return line;
     }
+    
+    std::string lexer_getsource(lexer& lex)
+    {
+        // Save current position and go to beginning of the stream
+        int saved = lex.in.tellg();
+        lex.in.clear();
+        lex.in.seekg(0, std::ios::beg);
+        
+        std::ostringstream ss;
+        ss << lex.in.rdbuf();
+        
+        // Restore saved position, clearing bad (or eof !) bits
+        lex.in.clear();
+        lex.in.seekg(saved, std::ios::beg);
+        
+        return ss.str();
+    }
 }
@@ -19,8 +19,7 @@
 #include "nut/pr_parser.h"
 #include "nut/pr_pratt.h"
 #include <string>
-#include <sstream>
-#include <stdexcept>
+#include <chrono>
 
 namespace pr
 {
@@ -86,13 +85,15 @@ namespace pr
     static ast_node* type_specifier(parser& par)
     {
         token tok = parser_expect(par, TOKEN_IDENTIFIER);
+        if (par.failed)
+            return 0;
         
         if (!parser_is_type_name(par, tok))
-            parser_parse_error(par, tok, "\"" + tok.value + "\" does not name a type");
+            return parser_error(par, tok, DIAG_NOT_A_TYPE, tok.value);
         
         // Create the AST node
-        type_specifier_node* node = new type_specifier_node(tok);
-        node->name = tok.value;
+        type_specifier_node* node = ast_create<type_specifier_node>(par.ctx.arena, tok);
+        node->name = ast_arena_string(par.ctx.arena, tok.value);
         return node;
     }
     
@@ -102,13 +103,16 @@ namespace pr
     static ast_node* argument_list(parser& par)
     {
         token tok = parser_expect(par, TOKEN_LEFT_PAREN);
+        if (par.failed)
+            return 0;
         
-        argument_list_node* node = new argument_list_node(tok);
+        argument_list_node* node = ast_create<argument_list_node>(par.ctx.arena, tok);
         
         while (lexer_peekt(par.lex) != TOKEN_RIGHT_PAREN)
         {
             // Create the argument AST node
-            argument_node* arg_node = new argument_node(lexer_peek(par.lex));
+            argument_node* arg_node = ast_create<argument_node>(par.ctx.arena, lexer_peek(par.lex));
+            ast_add_child(node, arg_node);
             
             // Get the argument's type
             ast_add_child(arg_node, type_specifier(par));
@@ -116,7 +120,9 @@ namespace pr
             // Get its name & check the declaration
             token tok = parser_expect(par, TOKEN_IDENTIFIER);
             parser_check_declaration(par, tok);
-            arg_node->name = tok.value;
+            if (par.failed)
+                return parser_abort(node);
+            arg_node->name = ast_arena_string(par.ctx.arena, tok.value);
             
             // Add it to the current scope
             symbol sym;
@@ -128,12 +134,13 @@ namespace pr
             // Eat comma, if needed
             if (lexer_peekt(par.lex) != TOKEN_RIGHT_PAREN)
                 parser_expect(par, TOKEN_COMMA);
-            
-            // Append the argument node the the list
-            ast_add_child(node, arg_node);
+            if (par.failed)
+                return parser_abort(node);
         }
         
         parser_expect(par, TOKEN_RIGHT_PAREN);
+        if (par.failed)
+            return parser_abort(node);
         
         return node;
     }
@@ -143,7 +150,7 @@ namespace pr
     //! declaration_stmt := type_specifier IDENTIFIER (EQUALS expression)? SEMICOLON
     static ast_node* declaration_stmt(parser& par)
     {
-        declaration_stmt_node* node = new declaration_stmt_node(lexer_peek(par.lex));
+        declaration_stmt_node* node = ast_create<declaration_stmt_node>(par.ctx.arena, lexer_peek(par.lex));
         
         // Type of the variable
         ast_add_child(node, type_specifier(par));
@@ -151,7 +158,9 @@ namespace pr
         // Get its name and check for multiple declarations
         token tok = parser_expect(par, TOKEN_IDENTIFIER);
         parser_check_declaration(par, tok);
-        node->name = tok.value;
+        if (par.failed)
+            return parser_abort(node);
+        node->name = ast_arena_string(par.ctx.arena, tok.value);
         
         // Add it to the current scope as soon as possible
         symbol sym;
@@ -168,6 +177,8 @@ namespace pr
         }
         
         parser_expect(par, TOKEN_SEMICOLON);
+        if (par.failed)
+            return parser_abort(node);
         
         return node;
     }
@@ -177,15 +188,17 @@ namespace pr
     //! return_stmt := RETURN expression? SEMICOLON
     static ast_node* return_stmt(parser& par)
     {
-        return_stmt_node* node = new return_stmt_node(lexer_peek(par.lex));
+        return_stmt_node* node = ast_create<return_stmt_node>(par.ctx.arena, lexer_peek(par.lex));
         
         parser_expect(par, TOKEN_RETURN);
         
         // Read in the eventual expression
-        if (lexer_peekt(par.lex) != TOKEN_SEMICOLON)
+        if (!par.failed && lexer_peekt(par.lex) != TOKEN_SEMICOLON)
             ast_add_child(node, expression(par));
         
         parser_expect(par, TOKEN_SEMICOLON);
+        if (par.failed)
+            return parser_abort(node);
         
         return node;
     }
@@ -197,7 +210,7 @@ namespace pr
     //!            | expression
     static ast_node* statement(parser& par)
     {
-        statement_node* node = new statement_node(lexer_peek(par.lex));
+        statement_node* node = ast_create<statement_node>(par.ctx.arena, lexer_peek(par.lex));
         
         // If the next token is a type name identifier, this
         //   is a declaration
@@ -220,6 +233,9 @@ namespace pr
             parser_expect(par, TOKEN_SEMICOLON);
         }
         
+        if (par.failed)
+            return parser_abort(node);
+        
         return node;
     }
     
@@ -229,13 +245,17 @@ namespace pr
     static ast_node* statement_block(parser& par)
     {
         token tok = parser_expect(par, TOKEN_LEFT_CURLY);
+        if (par.failed)
+            return 0;
         
-        statement_block_node* node = new statement_block_node(tok);
+        statement_block_node* node = ast_create<statement_block_node>(par.ctx.arena, tok);
         
-        while (lexer_peekt(par.lex) != TOKEN_RIGHT_CURLY)
+        while (!par.failed && lexer_peekt(par.lex) != TOKEN_RIGHT_CURLY)
             ast_add_child(node, statement(par));
         
         parser_expect(par, TOKEN_RIGHT_CURLY);
+        if (par.failed)
+            return parser_abort(node);
         
         return node;
     }
@@ -249,15 +269,19 @@ namespace pr
     {   
         // Return type
         ast_node* ret_type = type_specifier(par);
+        if (par.failed)
+            return 0;
         
         // Create node
-        function_decl_node* node = new function_decl_node(lexer_peek(par.lex));
+        function_decl_node* node = ast_create<function_decl_node>(par.ctx.arena, lexer_peek(par.lex));
         ast_add_child(node, ret_type);
         
         // Get its name and check for multiple definitions
         token tok = parser_expect(par, TOKEN_IDENTIFIER);
         parser_check_declaration(par, tok);
-        node->name = tok.value;
+        if (par.failed)
+            return parser_abort(node);
+        node->name = ast_arena_string(par.ctx.arena, tok.value);
         
         // Add the function to the current scope
         symbol sym;
@@ -273,11 +297,15 @@ namespace pr
         ast_add_child(node, argument_list(par));
         
         // Function body
-        ast_add_child(node, statement_block(par));
+        if (!par.failed)
+            ast_add_child(node, statement_block(par));
         
         // Pop the function scope
         scope_pop(par.ctx.scp);
         
+        if (par.failed)
+            return parser_abort(node);
+        
         return node;
     }
     
@@ -286,12 +314,15 @@ namespace pr
     //! program_decl := function_decl+ EOF
     static ast_node* program_decl(parser& par)
     {
-        program_decl_node* node = new program_decl_node(lexer_peek(par.lex));
+        program_decl_node* node = ast_create<program_decl_node>(par.ctx.arena, lexer_peek(par.lex));
         
         do
         {
             ast_add_child(node, function_decl(par));
-        } while (lexer_peekt(par.lex) != TOKEN_EOF);
+        } while (!par.failed && lexer_peekt(par.lex) != TOKEN_EOF);
+        
+        if (par.failed)
+            return parser_abort(node);
         
         return node;
     }
@@ -311,75 +342,73 @@ namespace pr
     
     ast_node* parser_parse_program(parser& par)
     {
-        return program_decl(par);
-    }
-    
-    void parser_parse_error(parser& par, token const& tok, std::string const& msg)
-    {
-        std::ostringstream ss;
-        ss << "parse error: " << parser_token_information(tok) << msg << std::endl;
-        ss << parser_error_line(par, tok);
-        throw std::logic_error(ss.str());
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        par.failed = false;
+        ast_node* node = program_decl(par);
+        par.time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        return node;
     }
     
-    std::string parser_token_information(token const& tok)
+    ast_node* parser_error(parser& par, token const& tok, int id,
+                           std::string const& arg0,
+                           std::string const& arg1,
+                           std::string const& arg2)
     {
-        std::ostringstream ss;
-        ss << "line " << tok.info.line;
-        ss << ", col " << tok.info.column << ": ";
-        return ss.str();
+        // Only the first error is recorded, the parser stops there
+        if (!par.failed)
+            diag_emit(par.ctx.diags, diag_make(id, tok, arg0, arg1, arg2));
+        
+        par.failed = true;
+        return 0;
     }
     
-    std::string parser_error_line(parser& par, token const& tok)
+    ast_node* parser_abort(ast_node*)
     {
-        std::ostringstream ss;
-        ss << lexer_getline(par.lex, tok.info.line) << std::endl;
-        
-        for (int i = 0; i < tok.info.column-1; ++i) ss << " ";
-        ss << "^";
-        for (int i = 0; i < ((int) tok.value.size())-1; ++i) ss << "~";
-        
-        return ss.str();
+        return 0;
     }
     
     token parser_expect(parser& par, int type, std::string const& err_msg, bool eat)
     {
-        std::string msg = err_msg;
+        if (par.failed)
+            return token();
         
-        if (!msg.size())
+        // The message is only looked up on errors
+        if (lexer_peekt(par.lex) != type)
         {
-            error_message* emsg = parser_find_default_error_message(type);
-            if (!emsg)
-                msg = "bogus bogus ! can't find a default error message for this token :(";
-            else
-                msg = emsg->message;
+            std::string msg = err_msg;
+            
+            if (!msg.size())
+            {
+                error_message* emsg = parser_find_default_error_message(type);
+                if (!emsg)
+                    msg = "bogus bogus ! can't find a default error message for this token :(";
+                else
+                    msg = emsg->message;
+            }
+            
+            parser_error(par, lexer_peek(par.lex), DIAG_PARSE_ERROR, msg);
+            return token();
         }
         
-        if (lexer_peekt(par.lex) != type)
-            parser_parse_error(par, lexer_peek(par.lex), msg);
-        
         return eat ? lexer_get(par.lex) : token();
     }
     
     void parser_check_declaration(parser& par, token const& tok)
     {
+        if (par.failed)
+            return;
+        
         symbol* sym = scope_find_innermost(par.ctx.scp, tok.value);
         symbol* glob_sym = scope_find(par.ctx.scp, tok.value);
         //! Issue an error either if :
         //!   - the symbol is already declared in the current scope layer
         //!   - the symbol is a builtin
-        if (sym || (glob_sym && glob_sym->flags & SYM_FLAG_BUILTIN))
-        {
-            std::ostringstream ss;
-            ss << "symbol `" << tok.value << "' is already declared ";
-            
-            if (sym && !(sym->flags & SYM_FLAG_BUILTIN))
-                ss << "(previously declared at line " << sym->info.line << ", col " << sym->info.column << ")";
-            else if (sym || glob_sym)
-                ss << "(`" << tok.value << "' is a builtin symbol)";
-            
-            parser_parse_error(par, tok, ss.str());
-        }
+        if (sym && !(sym->flags & SYM_FLAG_BUILTIN))
+            parser_error(par, tok, DIAG_REDECLARED, tok.value,
+                         std::to_string(sym->info.line), std::to_string(sym->info.column));
+        else if (sym || (glob_sym && glob_sym->flags & SYM_FLAG_BUILTIN))
+            parser_error(par, tok, DIAG_REDECLARED_BUILTIN, tok.value);
     }
     
     bool parser_is_type_name(parser& par, token const& tok)
@@ -19,15 +19,18 @@
 #include "nut/pr_pratt.h"
 #include "nut/pr_parser.h"
 #include "nut/pr_token.h"
-    
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+
 namespace pr
 {
     //! Forward declaration.
     static ast_node* pratt_expression(parser& par, int rbp = 0);
     
-    /***************************************/
-    /*** Default implementation (throws) ***/
-    /***************************************/
+    /*******************************************/
+    /*** Default implementation (errors out) ***/
+    /*******************************************/
     
     //! The base class for expression elements.
     //! We use a Pratt parser for every expression, therefore
@@ -35,8 +38,9 @@ namespace pr
     //!   class.
     //! We used a struct to avoid public: qualifiers (and for
     //!   consistency with the rest of the code).
-    //! The default nud and led handlers throws to signal a bogus operator
+    //! The default nud and led handlers record an error to signal a bogus operator
     //!   definitions.
+    //! Handlers return 0 on errors, dropping the nodes they were given.
     struct expr_element
     {
         token saved_tok;
@@ -47,14 +51,13 @@ namespace pr
         
         virtual ast_node* nud(parser& par)
         {
-            parser_parse_error(par, lexer_peek(par.lex), "nud BOGUS!");
-            return 0;
+            return parser_error(par, lexer_peek(par.lex), DIAG_PARSE_ERROR, "nud BOGUS!");
         }
         
-        virtual ast_node* led(parser& par, ast_node*)
+        virtual ast_node* led(parser& par, ast_node* left)
         {
-            parser_parse_error(par, lexer_peek(par.lex), "led BOGUS!");
-            return 0;
+            parser_abort(left);
+            return parser_error(par, lexer_peek(par.lex), DIAG_PARSE_ERROR, "led BOGUS!");
         }
     };
     
@@ -69,17 +72,19 @@ namespace pr
     //! An integer literal expression element.
     struct expr_integer_literal : public expr_element
     {
-        int value;
-        
         expr_integer_literal(token const& tok)
         {
             saved_tok = tok;
-            value = std::stoi(tok.value);
         }
         
-        ast_node* nud(parser&)
+        ast_node* nud(parser& par)
         {
-            integer_literal_expr_node* node = new integer_literal_expr_node(saved_tok);
+            errno = 0;
+            long value = std::strtol(saved_tok.value.c_str(), 0, 10);
+            if (errno == ERANGE || value > INT_MAX)
+                return parser_error(par, saved_tok, DIAG_INTEGER_TOO_LARGE, saved_tok.value);
+            
+            integer_literal_expr_node* node = ast_create<integer_literal_expr_node>(par.ctx.arena, saved_tok);
             node->value = value;
             return node;
         }
@@ -98,12 +103,11 @@ namespace pr
         
         ast_node* nud(parser& par)
         {
-            identifier_expr_node* node = new identifier_expr_node(saved_tok);
-            node->name = name;
-            
             if (!scope_find(par.ctx.scp, name))
-                parser_parse_error(par, saved_tok, "use of undeclared identifier '" + name + "'");
+                return parser_error(par, saved_tok, DIAG_UNDECLARED_IDENTIFIER, name);
             
+            identifier_expr_node* node = ast_create<identifier_expr_node>(par.ctx.arena, saved_tok);
+            node->name = ast_arena_string(par.ctx.arena, name);
             return node;
         }
     };
@@ -111,11 +115,11 @@ namespace pr
     /*************************************/
     /*** Automatic operator generation ***/
     /*************************************/
-
+    
     //! Used to allow macro expansion even with paste operator.
     #define CAT(a, ...) PRIMITIVE_CAT(a, __VA_ARGS__)
     #define PRIMITIVE_CAT(a, ...) a ## __VA_ARGS__
-        
+    
     //! Defines the expression element structure's name.
     #define ELEMENT_STRUCT_NAME(token) expr_ ## token
     //! Defines the LBP for left-associative elements.
@@ -126,7 +130,7 @@ namespace pr
     #define ELEMENT_LBP_CUSTOM(x) (x)
     //! Defines the LBP for an element depending on its associativity.
     #define ELEMENT_LBP(associativity) CAT(ELEMENT_LBP_, associativity)
-
+    
     //! Start an element structure declaration.
     #define ELEMENT_BEGIN(token_t, binary_lbp) \
         struct ELEMENT_STRUCT_NAME(token_t) : public expr_element \
@@ -136,7 +140,7 @@ namespace pr
                 saved_tok = tok; \
                 token_type = token_t; lbp = binary_lbp; \
             }
-            
+    
     //! Define an unary operator without node creation and with separate LBP.
     #define ELEMENT_UNARY_SHELL(unary_lbp) \
         ast_node* nud(parser& par) \
@@ -151,45 +155,45 @@ namespace pr
         { \
             ast_node* node = pratt_expression(par, unary_lbp); \
             parser_expect(par, token); \
-            return node; \
+            return par.failed ? parser_abort(node) : node; \
         }
     
     //! Define an unary operator with ast node creattion and separate LBP.
     #define ELEMENT_UNARY(node_type, unary_lbp) \
         ast_node* nud(parser& par) \
         { \
-            node_type* node = new node_type(saved_tok); \
+            node_type* node = ast_create<node_type>(par.ctx.arena, saved_tok); \
             ast_add_child(node, pratt_expression(par, unary_lbp)); \
-            return node; \
+            return par.failed ? parser_abort(node) : node; \
         }
-            
+    
     //! Define a binary operator (w/ associativity and node creation).
     #define ELEMENT_BINARY(node_type, associativity) \
         ast_node* led(parser& par, ast_node* left) \
         { \
-            node_type* node = new node_type(saved_tok); \
+            node_type* node = ast_create<node_type>(par.ctx.arena, saved_tok); \
             ast_add_child(node, left); \
             ast_add_child(node, pratt_expression(par, ELEMENT_LBP(associativity))); \
-            return node; \
+            return par.failed ? parser_abort(node) : node; \
         }
-            
+    
     //! Define a binary operator (w/ associativity and node creation)
     //!   that matches another token after parsing (for example parentheses '(' & ')').
     #define ELEMENT_BINARY_CONSUME(node_type, associativity, token) \
         ast_node* led(parser& par, ast_node* left) \
         { \
-            node_type* node = new node_type(saved_tok); \
+            node_type* node = ast_create<node_type>(par.ctx.arena, saved_tok); \
             ast_add_child(node, left); \
             ast_add_child(node, pratt_expression(par, ELEMENT_LBP(associativity))); \
             parser_expect(par, token); \
-            return node; \
+            return par.failed ? parser_abort(node) : node; \
         }
-        
+    
     //! Terminate an element structure declaration.
     #define ELEMENT_END() };
     
     #include "nut/pr_pratt_elements.inc"
-            
+    
     #undef ELEMENT_END
     #undef ELEMENT_BINARY_CONSUME
     #undef ELEMENT_BINARY
@@ -213,7 +217,7 @@ namespace pr
         //!
             case TOKEN_INTEGER:
                 return new expr_integer_literal(tok);
-                
+            
             case TOKEN_IDENTIFIER:
                 return new expr_identifier(tok);
                 break;
@@ -224,7 +228,7 @@ namespace pr
         #define ELEMENT_BEGIN(token_t, binary_lbp) \
             case token_t: \
                 return new ELEMENT_STRUCT_NAME(token_t)(tok);
-
+        
         #define ELEMENT_UNARY(node_type, lbp)
         #define ELEMENT_UNARY_SHELL(lbp)
         #define ELEMENT_UNARY_SHELL_CONSUME(lbp, token)
@@ -258,14 +262,14 @@ namespace pr
         tok = lexer_peek(par.lex);
         elem = find_expr_element_by_token(tok);
         if (!elem)
-            parser_parse_error(par, lexer_peek(par.lex), "expected expression");
+            return parser_error(par, lexer_peek(par.lex), DIAG_EXPECTED_EXPRESSION);
         
         // Eat the associated token and create the first ast node
         lexer_get(par.lex);
         ast_node* left = elem->nud(par);
         delete elem;
         
-        for (;;)
+        while (!par.failed)
         {
             // Find the operator element
             tok = lexer_peek(par.lex);
@@ -280,13 +284,13 @@ namespace pr
                 break;
             }
             
-            // Led expression
+            // Led expression (that frees left on errors)
             lexer_get(par.lex);
             left = elem->led(par, left);
             delete elem;
         }
         
-        return left;
+        return par.failed ? parser_abort(left) : left;
     }
     
     /*************************/
@@ -296,8 +300,10 @@ namespace pr
     ast_node* expression(parser& par)
     {
         ast_node* expr = pratt_expression(par);
+        if (!expr)
+            return 0;
         
-        expression_node* wrap = new expression_node(expr->saved_tok);
+        expression_node* wrap = ast_create<expression_node>(par.ctx.arena, expr->saved_tok);
         ast_add_child(wrap, expr);
         
         return wrap;
@@ -0,0 +1,252 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_callgraph.h"
+#include "nut/sem_workers.h"
+#include <algorithm>
+
+namespace sem
+{
+    using namespace pr;
+    
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! Find the strongly connected components, with Tarjan's algorithm.
+    //! It is iterative, so that long call chains don't overflow the stack.
+    //! Components are found callees first, which is the bottom-up order.
+    static void call_graph_tarjan(call_graph& graph)
+    {
+        int n = graph.nodes.size();
+        int counter = 0;
+        
+        std::vector<int> order(n, -1);
+        std::vector<int> low(n, 0);
+        std::vector<bool> stacked(n, false);
+        std::vector<int> stack;
+        
+        // The DFS stack : function index and next edge to follow
+        std::vector<std::pair<int, int> > dfs;
+        
+        for (int root = 0; root < n; ++root)
+        {
+            if (order[root] >= 0)
+                continue;
+            
+            dfs.push_back(std::make_pair(root, 0));
+            order[root] = low[root] = counter++;
+            stack.push_back(root);
+            stacked[root] = true;
+            
+            while (dfs.size())
+            {
+                int v = dfs.back().first;
+                int& edge = dfs.back().second;
+                
+                if (edge < (int) graph.nodes[v].callees.size())
+                {
+                    int w = graph.nodes[v].callees[edge++].callee;
+                    
+                    if (order[w] < 0)
+                    {
+                        dfs.push_back(std::make_pair(w, 0));
+                        order[w] = low[w] = counter++;
+                        stack.push_back(w);
+                        stacked[w] = true;
+                    }
+                    else if (stacked[w])
+                        low[v] = std::min(low[v], order[w]);
+                    
+                    continue;
+                }
+                
+                // All the callees are done, v is the root of a component
+                //   if it can't reach an older function on the stack
+                dfs.pop_back();
+                if (dfs.size())
+                    low[dfs.back().first] = std::min(low[dfs.back().first], low[v]);
+                
+                if (low[v] == order[v])
+                {
+                    std::vector<int> scc;
+                    int w;
+                    do
+                    {
+                        w = stack.back();
+                        stack.pop_back();
+                        stacked[w] = false;
+                        graph.nodes[w].scc = graph.sccs.size();
+                        scc.push_back(w);
+                    }
+                    while (w != v);
+                    
+                    std::sort(scc.begin(), scc.end());
+                    graph.sccs.push_back(scc);
+                }
+            }
+        }
+    }
+    
+    //! Group the components by level, a component's level being one more
+    //!   than the highest level of the components it calls.
+    static void call_graph_levels(call_graph& graph)
+    {
+        std::vector<int> level(graph.sccs.size(), 0);
+        
+        for (unsigned int i = 0; i < graph.sccs.size(); ++i)
+        {
+            for (unsigned int j = 0; j < graph.sccs[i].size(); ++j)
+            {
+                call_node& node = graph.nodes[graph.sccs[i][j]];
+                
+                for (unsigned int k = 0; k < node.callees.size(); ++k)
+                {
+                    int callee = graph.nodes[node.callees[k].callee].scc;
+                    if (callee != (int) i)
+                        level[i] = std::max(level[i], level[callee] + 1);
+                }
+            }
+            
+            if (level[i] >= (int) graph.levels.size())
+                graph.levels.resize(level[i] + 1);
+            graph.levels[level[i]].push_back(i);
+        }
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    call_graph call_graph_create(ast_node* program, std::vector<function*> const& externals)
+    {
+        call_graph graph;
+        
+        for (unsigned int i = 0; i < program->children.size(); ++i)
+        {
+            ast_node* node = program->children[i];
+            if (node->tag != FUNCTION_DECL || !node->decl)
+                continue;
+            
+            call_node cn;
+            cn.fun = node->decl->as_function;
+            cn.node = node;
+            cn.scc = -1;
+            
+            graph.index[cn.fun] = graph.nodes.size();
+            graph.nodes.push_back(cn);
+        }
+        
+        // The call sites of each function give the callee of each call
+        std::map<ast_node*, int> callees;
+        for (unsigned int i = 0; i < graph.nodes.size(); ++i)
+        {
+            std::vector<ast_node*>& uses = graph.nodes[i].fun->uses;
+            for (unsigned int j = 0; j < uses.size(); ++j)
+                callees[uses[j]] = i;
+        }
+        
+        std::map<ast_node*, function*> imported;
+        for (unsigned int i = 0; i < externals.size(); ++i)
+            for (unsigned int j = 0; j < externals[i]->uses.size(); ++j)
+                imported[externals[i]->uses[j]] = externals[i];
+        
+        for (unsigned int i = 0; i < graph.nodes.size(); ++i)
+        {
+            std::vector<ast_node*>& calls = graph.nodes[i].fun->calls;
+            
+            for (unsigned int j = 0; j < calls.size(); ++j)
+            {
+                std::map<ast_node*, int>::iterator it = callees.find(calls[j]);
+                if (it == callees.end())
+                {
+                    std::map<ast_node*, function*>::iterator ext = imported.find(calls[j]);
+                    std::vector<function*>& exts = graph.nodes[i].externals;
+                    
+                    if (ext != imported.end() && std::find(exts.begin(), exts.end(), ext->second) == exts.end())
+                        exts.push_back(ext->second);
+                    continue;
+                }
+                
+                call_edge edge;
+                edge.callee = it->second;
+                edge.site = calls[j];
+                graph.nodes[i].callees.push_back(edge);
+                
+                std::vector<int>& callers = graph.nodes[edge.callee].callers;
+                if (std::find(callers.begin(), callers.end(), (int) i) == callers.end())
+                    callers.push_back(i);
+            }
+        }
+        
+        call_graph_tarjan(graph);
+        call_graph_levels(graph);
+        
+        return graph;
+    }
+    
+    void call_graph_free(call_graph& graph)
+    {
+        graph.nodes.clear();
+        graph.index.clear();
+        graph.sccs.clear();
+        graph.levels.clear();
+    }
+    
+    bool call_graph_is_recursive(call_graph& graph, int scc)
+    {
+        if (graph.sccs[scc].size() > 1)
+            return true;
+        
+        call_node& node = graph.nodes[graph.sccs[scc][0]];
+        for (unsigned int i = 0; i < node.callees.size(); ++i)
+            if (graph.nodes[node.callees[i].callee].scc == scc)
+                return true;
+        
+        return false;
+    }
+    
+    void call_graph_run_bottom_up(call_graph& graph, int threads, std::function<void(int)> const& task)
+    {
+        for (unsigned int i = 0; i < graph.levels.size(); ++i)
+        {
+            std::vector<int>& level = graph.levels[i];
+            workers_run(threads, level.size(), [&](int j) { task(level[j]); });
+        }
+    }
+    
+    void call_graph_dump(call_graph& graph, std::ostream& os)
+    {
+        for (unsigned int i = 0; i < graph.sccs.size(); ++i)
+        {
+            os << "scc " << i << (call_graph_is_recursive(graph, i) ? " (recursive)" : "") << ":";
+            
+            for (unsigned int j = 0; j < graph.sccs[i].size(); ++j)
+            {
+                call_node& node = graph.nodes[graph.sccs[i][j]];
+                os << " " << node.fun->name << " ->";
+                
+                for (unsigned int k = 0; k < node.callees.size(); ++k)
+                    os << " " << graph.nodes[node.callees[k].callee].fun->name;
+                os << ";";
+            }
+            
+            os << std::endl;
+        }
+    }
+}
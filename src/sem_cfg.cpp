@@ -0,0 +1,202 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_cfg.h"
+
+namespace sem
+{
+    using namespace pr;
+    
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! The control-flow graph under construction, with a vector per block.
+    //! It is flattened into a cfg structure once complete.
+    struct cfg_builder
+    {
+        std::vector<std::vector<ast_node*> > stmts;
+        std::vector<std::vector<int> > succs;
+        std::vector<ast_node*> after;
+        
+        //! The block that statements are appended to.
+        int current;
+    };
+    
+    //! Create a new block, starting after the given jump statement (or 0).
+    static int cfg_new_block(cfg_builder& b, ast_node* after)
+    {
+        b.stmts.push_back(std::vector<ast_node*>());
+        b.succs.push_back(std::vector<int>());
+        b.after.push_back(after);
+        return b.stmts.size() - 1;
+    }
+    
+    //! Add the statements of a subtree to the graph.
+    static void cfg_build(cfg_builder& b, ast_node* node)
+    {
+        switch (node->tag)
+        {
+            case STATEMENT_BLOCK:
+                for (unsigned int i = 0; i < node->children.size(); ++i)
+                    cfg_build(b, node->children[i]);
+                break;
+            
+            //! The statement node is just a wrapper.
+            case STATEMENT:
+                cfg_build(b, node->children[0]);
+                break;
+            
+            //! Returns jump to the exit block, what follows them
+            //!   is in a new block.
+            case RETURN_STMT:
+                b.stmts[b.current].push_back(node);
+                b.succs[b.current].push_back(CFG_EXIT);
+                b.current = cfg_new_block(b, node);
+                break;
+            
+            default:
+                b.stmts[b.current].push_back(node);
+                break;
+        }
+    }
+    
+    //! Number the reachable blocks in reverse post-order.
+    //! The depth-first search is iterative, so that long chains of blocks
+    //!   don't overflow the stack.
+    static void cfg_number(cfg& graph)
+    {
+        std::vector<bool> visited(graph.blocks.size(), false);
+        std::vector<int> post;
+        
+        // The DFS stack : block and next successor to follow
+        std::vector<std::pair<int, int> > dfs;
+        dfs.push_back(std::make_pair((int) CFG_ENTRY, graph.blocks[CFG_ENTRY].succ_begin));
+        visited[CFG_ENTRY] = true;
+        
+        while (dfs.size())
+        {
+            int block = dfs.back().first;
+            int succ = dfs.back().second;
+            
+            if (succ < graph.blocks[block].succ_end)
+            {
+                ++dfs.back().second;
+                
+                int next = graph.succs[succ];
+                if (!visited[next])
+                {
+                    visited[next] = true;
+                    dfs.push_back(std::make_pair(next, graph.blocks[next].succ_begin));
+                }
+            }
+            else
+            {
+                post.push_back(block);
+                dfs.pop_back();
+            }
+        }
+        
+        graph.rpo.assign(post.rbegin(), post.rend());
+        for (unsigned int i = 0; i < graph.rpo.size(); ++i)
+            graph.blocks[graph.rpo[i]].rpo = i;
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    cfg cfg_create(ast_node* function)
+    {
+        cfg_builder b;
+        cfg_new_block(b, 0);
+        cfg_new_block(b, 0);
+        
+        // The body falls through to the exit block
+        b.current = CFG_ENTRY;
+        cfg_build(b, function->children[2]);
+        b.succs[b.current].push_back(CFG_EXIT);
+        
+        // Flatten the blocks, the predecessors being counted first
+        cfg graph;
+        graph.node = function;
+        
+        int n = b.stmts.size();
+        std::vector<int> pred_count(n, 0);
+        for (int i = 0; i < n; ++i)
+            for (unsigned int j = 0; j < b.succs[i].size(); ++j)
+                ++pred_count[b.succs[i][j]];
+        
+        graph.blocks.resize(n);
+        for (int i = 0, preds = 0; i < n; ++i)
+        {
+            cfg_block& block = graph.blocks[i];
+            
+            block.stmt_begin = graph.stmts.size();
+            graph.stmts.insert(graph.stmts.end(), b.stmts[i].begin(), b.stmts[i].end());
+            block.stmt_end = graph.stmts.size();
+            
+            block.succ_begin = graph.succs.size();
+            graph.succs.insert(graph.succs.end(), b.succs[i].begin(), b.succs[i].end());
+            block.succ_end = graph.succs.size();
+            
+            block.pred_begin = block.pred_end = preds;
+            preds += pred_count[i];
+            
+            block.rpo = -1;
+            block.after = b.after[i];
+        }
+        
+        graph.preds.resize(graph.succs.size());
+        for (int i = 0; i < n; ++i)
+            for (unsigned int j = 0; j < b.succs[i].size(); ++j)
+                graph.preds[graph.blocks[b.succs[i][j]].pred_end++] = i;
+        
+        cfg_number(graph);
+        
+        return graph;
+    }
+    
+    void cfg_free(cfg& graph)
+    {
+        graph.blocks.clear();
+        graph.stmts.clear();
+        graph.succs.clear();
+        graph.preds.clear();
+        graph.rpo.clear();
+    }
+    
+    void cfg_dump(cfg& graph, std::ostream& os)
+    {
+        for (unsigned int i = 0; i < graph.blocks.size(); ++i)
+        {
+            cfg_block& block = graph.blocks[i];
+            
+            os << "bb" << i;
+            if (block.rpo < 0)
+                os << " (unreachable)";
+            os << ": " << block.stmt_end - block.stmt_begin << " statements, preds";
+            for (int j = block.pred_begin; j < block.pred_end; ++j)
+                os << " bb" << graph.preds[j];
+            os << ", succs";
+            for (int j = block.succ_begin; j < block.succ_end; ++j)
+                os << " bb" << graph.succs[j];
+            os << std::endl;
+        }
+    }
+}
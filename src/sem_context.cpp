@@ -0,0 +1,45 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_context.h"
+
+namespace sem
+{
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    context context_create()
+    {
+        context ctx;
+        ctx.types = type_table_create();
+        ctx.variables = pool_create<variable>();
+        ctx.functions = pool_create<function>();
+        return ctx;
+    }
+    
+    void context_free(context& ctx)
+    {
+        ir_free(ctx.ir);
+        summary_free(ctx.imports);
+        ctx.globals.clear();
+        pool_free(ctx.functions);
+        pool_free(ctx.variables);
+        type_table_free(ctx.types);
+    }
+}
@@ -0,0 +1,347 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_dataflow.h"
+#include <map>
+#include <deque>
+
+namespace sem
+{
+    using namespace pr;
+    
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! Identifier nodes of a function, by variable index.
+    typedef std::map<ast_node*, int> variable_map;
+    
+    //! Collect the variable accesses of an expression, in evaluation order.
+    static void dataflow_collect(variable_map const& vars, ast_node* node, std::vector<dataflow_access>& out)
+    {
+        variable_map::const_iterator it;
+        dataflow_access access;
+        
+        switch (node->tag)
+        {
+            case IDENTIFIER_EXPR:
+                it = vars.find(node);
+                if (it != vars.end())
+                {
+                    access.var = it->second;
+                    access.def = false;
+                    access.node = node;
+                    out.push_back(access);
+                }
+                break;
+            
+            //! The value is computed before the variable is assigned.
+            case ASSIGNMENT_EXPR:
+                dataflow_collect(vars, node->children[1], out);
+                
+                it = vars.find(node->children[0]);
+                if (it == vars.end())
+                    dataflow_collect(vars, node->children[0], out);
+                else
+                {
+                    access.var = it->second;
+                    access.def = true;
+                    access.node = node->children[0];
+                    out.push_back(access);
+                }
+                break;
+            
+            //! Increments use, then assign their operand.
+            case INC_EXPR:
+            case DEC_EXPR:
+                dataflow_collect(vars, node->children[0], out);
+                
+                it = vars.find(node->children[0]);
+                if (it != vars.end())
+                {
+                    access.var = it->second;
+                    access.def = true;
+                    access.node = node->children[0];
+                    out.push_back(access);
+                }
+                break;
+            
+            //! Only the arguments of a call are evaluated.
+            case FUNCTION_CALL_EXPR:
+                if (node->children.size() > 1)
+                    dataflow_collect(vars, node->children[1], out);
+                break;
+            
+            //! An initialized declaration assigns its variable.
+            case DECLARATION_STMT:
+                if (node->children.size() > 1)
+                {
+                    dataflow_collect(vars, node->children[1], out);
+                    
+                    access.var = node->decl->as_variable->index;
+                    access.def = true;
+                    access.node = node;
+                    out.push_back(access);
+                }
+                break;
+            
+            default:
+                for (unsigned int i = 0; i < node->children.size(); ++i)
+                    dataflow_collect(vars, node->children[i], out);
+                break;
+        }
+    }
+    
+    //! Compute the meet of the neighbours' values of a block into value.
+    static void dataflow_meet(dataflow& df, std::vector<int> const& edges, int begin, int end,
+                              std::vector<bitvec> const& values, bitvec& value)
+    {
+        value = bitvec_create(df.size, df.meet == DATAFLOW_INTERSECTION);
+        
+        for (int i = begin; i < end; ++i)
+        {
+            bitvec const& other = values[edges[i]];
+            
+            for (unsigned int w = 0; w < value.words.size(); ++w)
+            {
+                if (df.meet == DATAFLOW_UNION)
+                    value.words[w] |= other.words[w];
+                else
+                    value.words[w] &= other.words[w];
+            }
+        }
+    }
+    
+    //! Apply a block's transfer function : output = gen | (input & ~kill).
+    //! Returns true if the output changed.
+    static bool dataflow_transfer(dataflow& df, int block, bitvec const& input, bitvec& output)
+    {
+        bool changed = false;
+        
+        for (unsigned int w = 0; w < output.words.size(); ++w)
+        {
+            unsigned long long word = df.gen[block].words[w] | (input.words[w] & ~df.kill[block].words[w]);
+            changed |= word != output.words[w];
+            output.words[w] = word;
+        }
+        
+        return changed;
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    bitvec bitvec_create(int size, bool value)
+    {
+        bitvec bv;
+        bv.size = size;
+        bv.words.assign((size + 63) / 64, value ? ~0ull : 0ull);
+        
+        // Keep the bits past the end cleared
+        if (value && size % 64)
+            bv.words.back() = (1ull << (size % 64)) - 1;
+        
+        return bv;
+    }
+    
+    dataflow dataflow_create(cfg& graph, int direction, int meet, int size)
+    {
+        dataflow df;
+        df.direction = direction;
+        df.meet = meet;
+        df.size = size;
+        
+        int n = graph.blocks.size();
+        df.boundary = bitvec_create(size);
+        df.gen.assign(n, bitvec_create(size));
+        df.kill.assign(n, bitvec_create(size));
+        
+        return df;
+    }
+    
+    void dataflow_solve(dataflow& df, cfg& graph)
+    {
+        int n = graph.blocks.size();
+        bool forward = df.direction == DATAFLOW_FORWARD;
+        
+        // Start from the neutral value of the meet
+        bitvec top = bitvec_create(df.size, df.meet == DATAFLOW_INTERSECTION);
+        df.in.assign(n, top);
+        df.out.assign(n, top);
+        
+        // Inputs and outputs in the direction of the analysis
+        std::vector<bitvec>& input = forward ? df.in : df.out;
+        std::vector<bitvec>& output = forward ? df.out : df.in;
+        
+        std::vector<int> const& sources = forward ? graph.preds : graph.succs;
+        std::vector<int> const& targets = forward ? graph.succs : graph.preds;
+        int boundary = forward ? (int) CFG_ENTRY : (int) CFG_EXIT;
+        
+        std::deque<int> work;
+        std::vector<bool> queued(n, false);
+        for (unsigned int i = 0; i < graph.rpo.size(); ++i)
+        {
+            int block = forward ? graph.rpo[i] : graph.rpo[graph.rpo.size() - 1 - i];
+            work.push_back(block);
+            queued[block] = true;
+        }
+        
+        while (work.size())
+        {
+            int block = work.front();
+            work.pop_front();
+            queued[block] = false;
+            
+            cfg_block& b = graph.blocks[block];
+            
+            if (block == boundary)
+                input[block] = df.boundary;
+            else if (forward)
+                dataflow_meet(df, sources, b.pred_begin, b.pred_end, output, input[block]);
+            else
+                dataflow_meet(df, sources, b.succ_begin, b.succ_end, output, input[block]);
+            
+            if (!dataflow_transfer(df, block, input[block], output[block]))
+                continue;
+            
+            int begin = forward ? b.succ_begin : b.pred_begin;
+            int end = forward ? b.succ_end : b.pred_end;
+            for (int i = begin; i < end; ++i)
+            {
+                int next = targets[i];
+                if (!queued[next] && cfg_reachable(graph, next))
+                {
+                    work.push_back(next);
+                    queued[next] = true;
+                }
+            }
+        }
+    }
+    
+    std::vector<std::vector<dataflow_access> > dataflow_accesses(cfg& graph, function* fun)
+    {
+        variable_map vars;
+        for (unsigned int i = 0; i < fun->variables.size(); ++i)
+        {
+            variable* var = fun->variables[i];
+            for (unsigned int j = 0; j < var->uses.size(); ++j)
+                vars[var->uses[j]] = var->index;
+        }
+        
+        std::vector<std::vector<dataflow_access> > accesses(graph.stmts.size());
+        for (unsigned int i = 0; i < graph.stmts.size(); ++i)
+            dataflow_collect(vars, graph.stmts[i], accesses[i]);
+        
+        return accesses;
+    }
+    
+    dataflow dataflow_liveness(cfg& graph, function* fun,
+                               std::vector<std::vector<dataflow_access> > const& accesses)
+    {
+        dataflow df = dataflow_create(graph, DATAFLOW_BACKWARD, DATAFLOW_UNION, fun->variables.size());
+        
+        // gen : used before being defined in the block, kill : defined in the block
+        for (unsigned int b = 0; b < graph.blocks.size(); ++b)
+        {
+            for (int s = graph.blocks[b].stmt_begin; s < graph.blocks[b].stmt_end; ++s)
+            {
+                for (unsigned int i = 0; i < accesses[s].size(); ++i)
+                {
+                    dataflow_access const& access = accesses[s][i];
+                    
+                    if (access.def)
+                        bitvec_set(df.kill[b], access.var);
+                    else if (!bitvec_get(df.kill[b], access.var))
+                        bitvec_set(df.gen[b], access.var);
+                }
+            }
+        }
+        
+        dataflow_solve(df, graph);
+        return df;
+    }
+    
+    dataflow dataflow_reaching_definitions(cfg& graph, function* fun,
+                                           std::vector<std::vector<dataflow_access> > const& accesses,
+                                           std::vector<dataflow_access>& sites)
+    {
+        // Number the definitions, and group them by variable
+        std::vector<std::vector<int> > var_sites(fun->variables.size());
+        sites.clear();
+        
+        for (unsigned int s = 0; s < accesses.size(); ++s)
+        {
+            for (unsigned int i = 0; i < accesses[s].size(); ++i)
+            {
+                if (accesses[s][i].def)
+                {
+                    var_sites[accesses[s][i].var].push_back(sites.size());
+                    sites.push_back(accesses[s][i]);
+                }
+            }
+        }
+        
+        dataflow df = dataflow_create(graph, DATAFLOW_FORWARD, DATAFLOW_UNION, sites.size());
+        
+        // gen : the last definition of each variable in the block,
+        //   kill : all the definitions of the variables defined in the block
+        for (unsigned int b = 0, site = 0; b < graph.blocks.size(); ++b)
+        {
+            for (int s = graph.blocks[b].stmt_begin; s < graph.blocks[b].stmt_end; ++s)
+            {
+                for (unsigned int i = 0; i < accesses[s].size(); ++i)
+                {
+                    if (!accesses[s][i].def)
+                        continue;
+                    
+                    std::vector<int> const& others = var_sites[accesses[s][i].var];
+                    for (unsigned int j = 0; j < others.size(); ++j)
+                    {
+                        bitvec_set(df.gen[b], others[j], false);
+                        bitvec_set(df.kill[b], others[j]);
+                    }
+                    
+                    bitvec_set(df.gen[b], site++);
+                }
+            }
+        }
+        
+        dataflow_solve(df, graph);
+        return df;
+    }
+    
+    dataflow dataflow_definite_assignment(cfg& graph, function* fun,
+                                          std::vector<std::vector<dataflow_access> > const& accesses)
+    {
+        dataflow df = dataflow_create(graph, DATAFLOW_FORWARD, DATAFLOW_INTERSECTION, fun->variables.size());
+        
+        for (int i = 0; i < fun->argument_count; ++i)
+            bitvec_set(df.boundary, fun->arguments[i].index);
+        
+        // gen : defined in the block, nothing is ever unassigned
+        for (unsigned int b = 0; b < graph.blocks.size(); ++b)
+            for (int s = graph.blocks[b].stmt_begin; s < graph.blocks[b].stmt_end; ++s)
+                for (unsigned int i = 0; i < accesses[s].size(); ++i)
+                    if (accesses[s][i].def)
+                        bitvec_set(df.gen[b], accesses[s][i].var);
+        
+        dataflow_solve(df, graph);
+        return df;
+    }
+}
@@ -0,0 +1,201 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_dce.h"
+
+namespace sem
+{
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! The state of an elimination.
+    //!
+    //! ir, fun:   the program's IR, and the function (in SSA form)
+    //! removable: the functions whose calls can be removed if unused
+    //! graph:     the function's control-flow graph
+    //! defs:      the pieces defining each register (several for a phi)
+    //! live:      the live pieces, by offset in the function
+    //! work:      the live pieces whose operands are to be marked live
+    struct dce_state
+    {
+        ir_program* ir;
+        int fun;
+        std::vector<bool> const* removable;
+        ir_graph graph;
+        
+        std::vector<std::vector<int> > defs;
+        std::vector<bool> live;
+        std::vector<int> work;
+    };
+    
+    //! Mark a piece live.
+    static void dce_mark(dce_state& st, int offset)
+    {
+        int i = offset - st.ir->functions[st.fun].begin;
+        if (st.live[i])
+            return;
+        
+        st.live[i] = true;
+        st.work.push_back(offset);
+    }
+    
+    //! Check if an operation has an effect, so it is live whether its result is
+    //!   used or not.
+    static bool dce_has_effect(dce_state& st, piece const& pc)
+    {
+        switch (pc.op)
+        {
+            case OP_POP_RET:
+            case OP_JUMP:
+            case OP_RETURN:
+            case OP_TAIL_CALL:
+                return true;
+            
+            // Division by zero and overflow trap at run time
+            case OP_DIV:
+                return pc.targets[2].tag != TG_CONSTANT || !pc.targets[2].value || pc.targets[2].value == -1;
+            
+            case OP_CALL:
+                return !(*st.removable)[pc.targets[0].value];
+        }
+        
+        return false;
+    }
+    
+    //! Mark the values used by a live piece.
+    //! A call's result keeps the call alive, and a call keeps its arguments.
+    static void dce_visit(dce_state& st, int offset)
+    {
+        piece& pc = st.ir->pieces[offset];
+        if (pc.tag != PIECE_OPERATION)
+            return;
+        
+        for (int j = ir_defines(pc) ? 1 : 0; j < pc.count; ++j)
+        {
+            target& tg = pc.targets[j];
+            if (tg.tag != TG_REGISTER)
+                continue;
+            
+            for (unsigned int k = 0; k < st.defs[tg.value].size(); ++k)
+                dce_mark(st, st.defs[tg.value][k]);
+        }
+        
+        if (pc.op == OP_PUSH_RET)
+            dce_mark(st, offset - 1);
+        else if (pc.op == OP_CALL || pc.op == OP_TAIL_CALL)
+        {
+            for (int j = offset - pc.targets[1].value; j < offset; ++j)
+                dce_mark(st, j);
+        }
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    std::vector<bool> dce_removable_calls(ir_program& ir, call_graph& graph)
+    {
+        // Components are ordered bottom-up, so callees are done first
+        std::vector<bool> returns(graph.sccs.size(), false);
+        for (unsigned int c = 0; c < graph.sccs.size(); ++c)
+        {
+            returns[c] = !call_graph_is_recursive(graph, c);
+            
+            for (unsigned int i = 0; i < graph.sccs[c].size() && returns[c]; ++i)
+            {
+                call_node& node = graph.nodes[graph.sccs[c][i]];
+                for (unsigned int j = 0; j < node.callees.size(); ++j)
+                    if (!returns[graph.nodes[node.callees[j].callee].scc])
+                        returns[c] = false;
+            }
+        }
+        
+        std::vector<bool> removable(ir.functions.size(), false);
+        for (unsigned int i = 0; i < ir.functions.size(); ++i)
+        {
+            function* fun = ir.functions[i].fun;
+            std::map<function*, int>::iterator it = graph.index.find(fun);
+            
+            if (it != graph.index.end() && fun->purity == PURITY_PURE)
+                removable[i] = returns[graph.nodes[it->second].scc];
+        }
+        
+        return removable;
+    }
+    
+    int dce_run(ir_program& ir, int fun, std::vector<bool> const& removable)
+    {
+        ir_function& f = ir.functions[fun];
+        if (!f.ssa)
+            return 0;
+        
+        dce_state st;
+        st.ir = &ir;
+        st.fun = fun;
+        st.removable = &removable;
+        st.graph = ir_graph_create(ir, fun);
+        st.defs.resize(f.registers);
+        st.live.assign(f.end - f.begin, false);
+        
+        for (unsigned int bl = 0; bl < st.graph.blocks.size(); ++bl)
+        {
+            if (st.graph.blocks[bl].rpo < 0)
+                continue;
+            
+            for (int i = st.graph.blocks[bl].begin; i < st.graph.blocks[bl].end; ++i)
+            {
+                piece& pc = ir.pieces[i];
+                
+                if (pc.tag == PIECE_LABEL || dce_has_effect(st, pc))
+                    dce_mark(st, i);
+                else if (ir_defines(pc))
+                    st.defs[pc.targets[0].value].push_back(i);
+            }
+        }
+        
+        while (st.work.size())
+        {
+            int offset = st.work.back();
+            st.work.pop_back();
+            dce_visit(st, offset);
+        }
+        
+        // Rewrite the reachable blocks with their live pieces only
+        std::vector<piece> body;
+        
+        for (unsigned int bl = 0; bl < st.graph.blocks.size(); ++bl)
+        {
+            if (st.graph.blocks[bl].rpo < 0)
+                continue;
+            
+            for (int i = st.graph.blocks[bl].begin; i < st.graph.blocks[bl].end; ++i)
+            {
+                if (st.live[i - f.begin])
+                    body.push_back(ir.pieces[i]);
+            }
+        }
+        
+        int removed = (f.end - f.begin) - body.size();
+        
+        ir_graph_free(st.graph);
+        ir_replace(ir, fun, body);
+        
+        return removed;
+    }
+}
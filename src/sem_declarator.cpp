@@ -42,42 +42,47 @@ namespace sem
         tp->tag = TYPE_DECLARATOR;
         tp->name = name;
         tp->flags = flags;
+        tp->id = -1;
+        tp->kind = TYPE_KIND_BUILTIN;
+        tp->base = 0;
+        tp->length = 0;
         return tp;
     }
     
-    variable* variable_create(std::string const& name)
+    void type_free(type* tp)
     {
-        variable* var = new variable();
-        var->tag = VARIABLE_DECLARATOR;
+        delete tp;
+    }
+    
+    variable* variable_create(pool<variable>& variables, std::string const& name)
+    {
+        variable* var = variables_create(variables, 1);
         var->name = name;
-        var->tp = 0;
         return var;
     }
     
-    function* function_create(std::string const& name)
+    variable* variables_create(pool<variable>& variables, int count)
     {
-        function* fun = new function();
+        variable* vars = pool_alloc(variables, count);
+        for (int i = 0; i < count; ++i)
+        {
+            vars[i].tag = VARIABLE_DECLARATOR;
+            vars[i].tp = 0;
+            vars[i].index = -1;
+        }
+        return vars;
+    }
+    
+    function* function_create(pool<function>& functions, std::string const& name)
+    {
+        function* fun = pool_alloc(functions);
         fun->tag = FUNCTION_DECLARATOR;
         fun->name = name;
+        fun->tp = 0;
         fun->ret_tp = 0;
+        fun->arguments = 0;
+        fun->argument_count = 0;
+        fun->purity = PURITY_EFFECTFUL;
         return fun;
     }
-    
-    void declarator_free(declarator* decl)
-    {
-        switch (decl->tag)
-        {
-            case VARIABLE_DECLARATOR:
-                break;
-                
-            case FUNCTION_DECLARATOR:
-            {
-                for (unsigned int i = 0; i < decl->as_function->arguments.size(); ++i)
-                    declarator_free(decl->as_function->arguments[i]);
-                break;
-            }
-        }
-        
-        delete decl;
-    }
 }
@@ -0,0 +1,299 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_eval.h"
+
+namespace sem
+{
+    using namespace pr;
+    
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! A call frame.
+    //!
+    //! fun:      the interpreted function
+    //! values:   the variables values, by index
+    //! assigned: the variables that have been assigned
+    struct eval_frame
+    {
+        eval_function* fun;
+        std::vector<int> values;
+        std::vector<bool> assigned;
+    };
+    
+    //! Get (or build) an interpreted function.
+    static eval_function& eval_get_function(evaluator& ev, function* fun)
+    {
+        std::map<function*, eval_function>::iterator it = ev.functions.find(fun);
+        if (it != ev.functions.end())
+            return it->second;
+        
+        eval_function& ef = ev.functions[fun];
+        ef.graph = cfg_create(ev.graph->nodes[ev.graph->index[fun]].node);
+        
+        for (unsigned int i = 0; i < fun->variables.size(); ++i)
+        {
+            variable* var = fun->variables[i];
+            for (unsigned int j = 0; j < var->uses.size(); ++j)
+                ef.locals[var->uses[j]] = var->index;
+        }
+        
+        return ef;
+    }
+    
+    //! Forward declaration.
+    static bool eval_expr(evaluator& ev, eval_frame& frame, ast_node* node, int& value);
+    
+    //! Assign a variable designated by an IDENTIFIER_EXPR node.
+    static bool eval_assign(eval_frame& frame, ast_node* target, int value)
+    {
+        std::map<ast_node*, int>::iterator it = frame.fun->locals.find(target);
+        if (it == frame.fun->locals.end())
+            return false;
+        
+        frame.values[it->second] = value;
+        frame.assigned[it->second] = true;
+        return true;
+    }
+    
+    //! Evaluate a call expression.
+    static bool eval_call_expr(evaluator& ev, eval_frame& frame, ast_node* node, int& value)
+    {
+        std::map<ast_node*, function*>::iterator it = ev.callees.find(node);
+        if (it == ev.callees.end())
+            return false;
+        
+        std::vector<ast_node*> arg_nodes;
+        ast_call_arguments(node, arg_nodes);
+        
+        std::vector<int> args(arg_nodes.size());
+        for (unsigned int i = 0; i < arg_nodes.size(); ++i)
+            if (!eval_expr(ev, frame, arg_nodes[i], args[i]))
+                return false;
+        
+        return evaluator_call(ev, it->second, args, value);
+    }
+    
+    //! Evaluate an expression.
+    static bool eval_expr(evaluator& ev, eval_frame& frame, ast_node* node, int& value)
+    {
+        if (++ev.steps > ev.budget)
+            return false;
+        
+        int lhs, rhs;
+        
+        switch (node->tag)
+        {
+            case EXPRESSION:
+                return eval_expr(ev, frame, node->children[0], value);
+            
+            case INTEGER_LITERAL_EXPR:
+                value = node->as_integer_literal_expr->value;
+                return true;
+            
+            case IDENTIFIER_EXPR:
+            {
+                std::map<ast_node*, int>::iterator it = frame.fun->locals.find(node);
+                if (it == frame.fun->locals.end() || !frame.assigned[it->second])
+                    return false;
+                
+                value = frame.values[it->second];
+                return true;
+            }
+            
+            case FUNCTION_CALL_EXPR:
+                return eval_call_expr(ev, frame, node, value);
+            
+            case INC_EXPR:
+            case DEC_EXPR:
+                if (!eval_expr(ev, frame, node->children[0], lhs))
+                    return false;
+                
+                value = eval_wrap((long long) lhs + (node->tag == INC_EXPR ? 1 : -1));
+                return eval_assign(frame, node->children[0], value);
+            
+            case NEG_EXPR:
+                if (!eval_expr(ev, frame, node->children[0], lhs))
+                    return false;
+                
+                value = eval_wrap(-(long long) lhs);
+                return true;
+            
+            case NOT_EXPR:
+                if (!eval_expr(ev, frame, node->children[0], lhs))
+                    return false;
+                
+                value = !lhs;
+                return true;
+            
+            case ASSIGNMENT_EXPR:
+                if (!eval_expr(ev, frame, node->children[1], value))
+                    return false;
+                
+                return eval_assign(frame, node->children[0], value);
+            
+            case LIST_EXPR:
+                return eval_expr(ev, frame, node->children[0], lhs) &&
+                       eval_expr(ev, frame, node->children[1], value);
+            
+            case ADD_EXPR:
+            case SUB_EXPR:
+            case MUL_EXPR:
+            case DIV_EXPR:
+                if (!eval_expr(ev, frame, node->children[0], lhs) ||
+                    !eval_expr(ev, frame, node->children[1], rhs))
+                    return false;
+                
+                switch (node->tag)
+                {
+                    case ADD_EXPR: value = eval_wrap((long long) lhs + rhs); break;
+                    case SUB_EXPR: value = eval_wrap((long long) lhs - rhs); break;
+                    case MUL_EXPR: value = eval_wrap((long long) lhs * rhs); break;
+                    
+                    // Division by zero (and overflow) are left for run time
+                    case DIV_EXPR:
+                        if (!rhs || (lhs == (int) 0x80000000 && rhs == -1))
+                            return false;
+                        value = lhs / rhs;
+                        break;
+                }
+                return true;
+        }
+        
+        return false;
+    }
+    
+    //! Execute a statement, setting returned for a return statement.
+    //! Returns false if the evaluation fails.
+    static bool eval_stmt(evaluator& ev, eval_frame& frame, ast_node* node, int& result, bool& returned)
+    {
+        int value;
+        
+        switch (node->tag)
+        {
+            case DECLARATION_STMT:
+                if (node->children.size() < 2)
+                    return true;
+                
+                if (!eval_expr(ev, frame, node->children[1], value))
+                    return false;
+                
+                frame.values[node->decl->as_variable->index] = value;
+                frame.assigned[node->decl->as_variable->index] = true;
+                return true;
+            
+            case RETURN_STMT:
+                if (node->children.empty())
+                    return false;
+                
+                returned = true;
+                return eval_expr(ev, frame, node->children[0], result);
+            
+            default:
+                return eval_expr(ev, frame, node, value);
+        }
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    evaluator evaluator_create(call_graph& graph, int budget)
+    {
+        evaluator ev;
+        ev.graph = &graph;
+        ev.budget = budget;
+        ev.steps = 0;
+        ev.depth = 0;
+        
+        for (unsigned int i = 0; i < graph.nodes.size(); ++i)
+        {
+            std::vector<call_edge>& callees = graph.nodes[i].callees;
+            for (unsigned int j = 0; j < callees.size(); ++j)
+                ev.callees[callees[j].site] = graph.nodes[callees[j].callee].fun;
+        }
+        
+        return ev;
+    }
+    
+    void evaluator_free(evaluator& ev)
+    {
+        std::map<function*, eval_function>::iterator it;
+        for (it = ev.functions.begin(); it != ev.functions.end(); ++it)
+            cfg_free(it->second.graph);
+        
+        ev.functions.clear();
+        ev.callees.clear();
+    }
+    
+    bool evaluator_call(evaluator& ev, function* fun, std::vector<int> const& args, int& result)
+    {
+        if (fun->purity != PURITY_PURE || (int) args.size() != fun->argument_count)
+            return false;
+        
+        // Each top-level evaluation gets the whole budget
+        if (!ev.depth)
+            ev.steps = 0;
+        
+        if (ev.depth >= EVAL_MAX_DEPTH)
+            return false;
+        
+        eval_frame frame;
+        frame.fun = &eval_get_function(ev, fun);
+        frame.values.assign(fun->variables.size(), 0);
+        frame.assigned.assign(fun->variables.size(), false);
+        
+        for (unsigned int i = 0; i < args.size(); ++i)
+        {
+            frame.values[i] = args[i];
+            frame.assigned[i] = true;
+        }
+        
+        // Run the blocks up to a return, following their single successor
+        //   (falling off the end of the body gives no value)
+        cfg& graph = frame.fun->graph;
+        int block = CFG_ENTRY;
+        bool ok = true;
+        bool returned = false;
+        
+        ++ev.depth;
+        
+        while (ok && !returned && block != CFG_EXIT)
+        {
+            cfg_block& b = graph.blocks[block];
+            for (int s = b.stmt_begin; ok && !returned && s < b.stmt_end; ++s)
+                ok = eval_stmt(ev, frame, graph.stmts[s], result, returned);
+            
+            if (b.succ_end - b.succ_begin != 1)
+                ok = false;
+            else
+                block = graph.succs[b.succ_begin];
+        }
+        
+        --ev.depth;
+        
+        return ok && returned;
+    }
+    
+    void evaluator_forget(evaluator& ev, ast_node* site)
+    {
+        ev.callees.erase(site);
+    }
+}
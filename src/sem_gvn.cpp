@@ -0,0 +1,279 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_gvn.h"
+#include "nut/sem_ssa.h"
+#include <algorithm>
+#include <map>
+
+namespace sem
+{
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! An operation's hash key : its opcode, then its operands' tags and values.
+    typedef std::vector<int> gvn_key;
+    
+    //! The available values, by key.
+    typedef std::map<gvn_key, target> gvn_table;
+    
+    //! The state of a value numbering.
+    //!
+    //! ir, fun:   the program's IR, and the function (in SSA form)
+    //! graph:     the function's control-flow graph
+    //! dom:       its dominator tree
+    //! values:    the value of each register (itself unless it is redundant)
+    //! removed:   the removed pieces, by offset in the function
+    //! available: the values available in the current block, from its dominators
+    //! log:       the keys made available, in order, to leave their scope
+    //! count:     the number of removed operations
+    struct gvn_state
+    {
+        ir_program* ir;
+        int fun;
+        ir_graph graph;
+        dominators dom;
+        
+        std::vector<target> values;
+        std::vector<bool> removed;
+        
+        gvn_table available;
+        std::vector<gvn_table::iterator> log;
+        int count;
+    };
+    
+    //! Get the value of a target (values are always recorded resolved).
+    static target gvn_resolve(gvn_state& st, target const& tg)
+    {
+        if (tg.tag == TG_REGISTER)
+            return st.values[tg.value];
+        return tg;
+    }
+    
+    //! Check if two targets are the same.
+    static bool gvn_same(target const& a, target const& b)
+    {
+        return a.tag == b.tag && a.value == b.value;
+    }
+    
+    //! Append a target's value to a key.
+    static void gvn_key_operand(gvn_state& st, gvn_key& key, target const& tg)
+    {
+        target value = gvn_resolve(st, tg);
+        key.push_back(value.tag);
+        key.push_back(value.value);
+    }
+    
+    //! Give a register the value available for a key, or make its own value
+    //!   available for it.
+    //! Returns true if the register is redundant.
+    static bool gvn_number(gvn_state& st, gvn_key const& key, int reg)
+    {
+        gvn_table::iterator it = st.available.find(key);
+        if (it != st.available.end())
+        {
+            st.values[reg] = it->second;
+            ++st.count;
+            return true;
+        }
+        
+        st.log.push_back(st.available.insert(std::make_pair(key, ir_target(TG_REGISTER, reg))).first);
+        return false;
+    }
+    
+    //! Number the phis and the operations of a block.
+    static void gvn_block(gvn_state& st, int bl)
+    {
+        ir_program& ir = *st.ir;
+        ir_function& f = ir.functions[st.fun];
+        ir_block& block = st.graph.blocks[bl];
+        int i = block.begin + 1;
+        
+        // A phi whose values are all the same (or itself) is that value
+        while (i < block.end && ir.pieces[i].op == OP_PHI)
+        {
+            int reg = ir.pieces[i].targets[0].value;
+            int first = i;
+            
+            bool same = true;
+            target value = ir_target(TG_REGISTER, reg);
+            
+            for (; i < block.end && ir.pieces[i].op == OP_PHI && ir.pieces[i].targets[0].value == reg; ++i)
+            {
+                target incoming = gvn_resolve(st, ir.pieces[i].targets[1]);
+                if (incoming.tag == TG_REGISTER && incoming.value == reg)
+                    continue;
+                
+                if (value.tag == TG_REGISTER && value.value == reg)
+                    value = incoming;
+                else if (!gvn_same(value, incoming))
+                    same = false;
+            }
+            
+            if (same && !(value.tag == TG_REGISTER && value.value == reg))
+            {
+                st.values[reg] = value;
+                ++st.count;
+                
+                for (int j = first; j < i; ++j)
+                    st.removed[j - f.begin] = true;
+            }
+        }
+        
+        for (; i < block.end; ++i)
+        {
+            piece& pc = ir.pieces[i];
+            gvn_key key(1, pc.op);
+            
+            switch (pc.op)
+            {
+                case OP_ADD:
+                case OP_SUB:
+                case OP_MUL:
+                case OP_DIV:
+                {
+                    gvn_key lhs, rhs;
+                    gvn_key_operand(st, lhs, pc.targets[1]);
+                    gvn_key_operand(st, rhs, pc.targets[2]);
+                    
+                    // Commutative operations have their operands sorted
+                    if ((pc.op == OP_ADD || pc.op == OP_MUL) && rhs < lhs)
+                        lhs.swap(rhs);
+                    
+                    key.insert(key.end(), lhs.begin(), lhs.end());
+                    key.insert(key.end(), rhs.begin(), rhs.end());
+                    
+                    st.removed[i - f.begin] = gvn_number(st, key, pc.targets[0].value);
+                    break;
+                }
+                
+                case OP_NEG:
+                case OP_NOT:
+                    gvn_key_operand(st, key, pc.targets[1]);
+                    st.removed[i - f.begin] = gvn_number(st, key, pc.targets[0].value);
+                    break;
+                
+                //! Pure calls whose result is used are numbered with their arguments,
+                //!   the PUSH pieces right before them.
+                case OP_CALL:
+                {
+                    function* callee = ir.functions[pc.targets[0].value].fun;
+                    int count = pc.targets[1].value;
+                    
+                    if (callee->purity != PURITY_PURE || i + 1 >= block.end || ir.pieces[i + 1].op != OP_PUSH_RET)
+                        break;
+                    
+                    key.push_back(pc.targets[0].value);
+                    for (int j = i - count; j < i; ++j)
+                        gvn_key_operand(st, key, ir.pieces[j].targets[0]);
+                    
+                    if (gvn_number(st, key, ir.pieces[i + 1].targets[0].value))
+                    {
+                        for (int j = i - count; j <= i + 1; ++j)
+                            st.removed[j - f.begin] = true;
+                    }
+                    
+                    ++i;
+                    break;
+                }
+            }
+        }
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    int gvn_run(ir_program& ir, int fun)
+    {
+        ir_function& f = ir.functions[fun];
+        if (!f.ssa)
+            return 0;
+        
+        gvn_state st;
+        st.ir = &ir;
+        st.fun = fun;
+        st.graph = ir_graph_create(ir, fun);
+        st.dom = dominators_create(st.graph);
+        st.removed.assign(f.end - f.begin, false);
+        st.count = 0;
+        
+        for (int i = 0; i < f.registers; ++i)
+            st.values.push_back(ir_target(TG_REGISTER, i));
+        
+        // Walk the dominator tree, the values of a block leaving the table
+        //   once its subtree is done (marked by a negative entry)
+        std::vector<std::pair<int, unsigned int> > work;
+        if (st.graph.rpo.size())
+            work.push_back(std::make_pair(st.graph.rpo[0], 0u));
+        
+        while (work.size())
+        {
+            int bl = work.back().first;
+            unsigned int mark = work.back().second;
+            work.pop_back();
+            
+            if (bl < 0)
+            {
+                while (st.log.size() > mark)
+                {
+                    st.available.erase(st.log.back());
+                    st.log.pop_back();
+                }
+                continue;
+            }
+            
+            work.push_back(std::make_pair(-1, (unsigned int) st.log.size()));
+            gvn_block(st, bl);
+            
+            for (unsigned int i = 0; i < st.dom.children[bl].size(); ++i)
+                work.push_back(std::make_pair(st.dom.children[bl][i], 0u));
+        }
+        
+        // Rewrite the blocks without the removed pieces, each register being
+        //   replaced by its value
+        std::vector<piece> body;
+        for (unsigned int bl = 0; bl < st.graph.blocks.size(); ++bl)
+        {
+            if (st.graph.blocks[bl].rpo < 0)
+                continue;
+            
+            for (int i = st.graph.blocks[bl].begin; i < st.graph.blocks[bl].end; ++i)
+            {
+                if (st.removed[i - f.begin])
+                    continue;
+                
+                piece pc = ir.pieces[i];
+                if (pc.tag == PIECE_OPERATION)
+                    for (int j = ir_defines(pc) ? 1 : 0; j < pc.count; ++j)
+                        if (pc.targets[j].tag == TG_REGISTER)
+                            pc.targets[j] = gvn_resolve(st, pc.targets[j]);
+                
+                body.push_back(pc);
+            }
+        }
+        
+        dominators_free(st.dom);
+        ir_graph_free(st.graph);
+        
+        ir_replace(ir, fun, body);
+        
+        return st.count;
+    }
+}
@@ -0,0 +1,358 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_inline.h"
+#include "nut/sem_sccp.h"
+#include "nut/sem_gvn.h"
+#include "nut/sem_dce.h"
+#include <algorithm>
+
+namespace sem
+{
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! Remap a target of an inlined piece : labels are moved past the caller's
+    //!   (the callee's entry becoming the split block), registers too, and the
+    //!   arguments are replaced by their values.
+    static target inline_remap(target tg, int entry, int split, int label_base, int register_base, std::vector<target> const& args)
+    {
+        if (tg.tag == TG_LABEL)
+            tg.value = tg.value == entry ? split : tg.value + label_base;
+        else if (tg.tag == TG_REGISTER)
+        {
+            if (tg.value < (int) args.size())
+                return args[tg.value];
+            tg.value += register_base - args.size();
+        }
+        
+        return tg;
+    }
+    
+    //! Replace the predecessor label of the phis of a range of pieces.
+    static void inline_rename_preds(std::vector<piece>& body, int begin, int end, int from, int to)
+    {
+        for (int i = begin; i < end; ++i)
+            if (body[i].tag == PIECE_OPERATION && body[i].op == OP_PHI && body[i].targets[2].value == from)
+                body[i].targets[2].value = to;
+    }
+    
+    //! Inline a call (the offset of its CALL piece) into its caller.
+    //! The caller's block is split around the call : its head goes on with the
+    //!   callee's entry block, and the returning blocks jump to its tail, starting
+    //!   with a phi for the returned value (a tail call being inlined as a call
+    //!   whose value is returned). A single returning block coming last goes on
+    //!   with the tail instead.
+    //! Returns the calls added to the caller, by callee.
+    static std::vector<int> inline_call(ir_program& ir, int fun, int call)
+    {
+        ir_function& f = ir.functions[fun];
+        int callee = ir.pieces[call].targets[0].value;
+        int count = ir.pieces[call].targets[1].value;
+        ir_function& g = ir.functions[callee];
+        ir_graph inlined = ir_graph_create(ir, callee);
+        
+        int head = f.begin;
+        for (int i = f.begin; i < call; ++i)
+            if (ir.pieces[i].tag == PIECE_LABEL)
+                head = i;
+        
+        int split = ir.pieces[head].targets[0].value;
+        int entry = ir.pieces[g.begin].targets[0].value;
+        int label_base = f.labels.size();
+        int register_base = f.registers;
+        int tail = label_base + g.labels.size();
+        
+        std::vector<target> args;
+        for (int i = call - count; i < call; ++i)
+            args.push_back(ir.pieces[i].targets[0]);
+        
+        int result = -1;
+        if (call + 1 < f.end && ir.pieces[call + 1].op == OP_PUSH_RET)
+            result = ir.pieces[call + 1].targets[0].value;
+        
+        // The head of the split block, then the callee's body without its label
+        std::vector<piece> body(ir.pieces.begin() + f.begin, ir.pieces.begin() + call - count);
+        int head_end = body.size();
+        
+        std::vector<int> calls(ir.functions.size(), 0);
+        std::vector<std::pair<target, int> > returned;
+        int extra = 0;
+        
+        for (unsigned int bl = 0; bl < inlined.blocks.size(); ++bl)
+        {
+            ir_block& block = inlined.blocks[bl];
+            if (block.rpo < 0 || ir.pieces[block.end - 1].op == OP_RETURN)
+                continue;
+            
+            int label = inline_remap(ir.pieces[block.begin].targets[0], entry, split, label_base, register_base, args).value;
+            
+            for (int i = block.begin + (bl ? 0 : 1); i < block.end; ++i)
+            {
+                piece pc = ir.pieces[i];
+                for (int j = 0; j < pc.count; ++j)
+                    pc.targets[j] = inline_remap(pc.targets[j], entry, split, label_base, register_base, args);
+                
+                if (pc.tag == PIECE_OPERATION && pc.op == OP_POP_RET)
+                {
+                    returned.push_back(std::make_pair(pc.targets[0], label));
+                    continue;
+                }
+                
+                // A tail call is inlined as a call whose value is returned
+                if (pc.tag == PIECE_OPERATION && pc.op == OP_TAIL_CALL)
+                {
+                    target value = ir_target(TG_REGISTER, register_base + g.registers - count + extra++);
+                    
+                    pc.op = OP_CALL;
+                    body.push_back(pc);
+                    ++calls[pc.targets[0].value];
+                    
+                    if (result >= 0)
+                    {
+                        pc.op = OP_PUSH_RET;
+                        pc.count = 1;
+                        pc.targets[0] = value;
+                        body.push_back(pc);
+                    }
+                    
+                    returned.push_back(std::make_pair(value, label));
+                    
+                    pc.op = OP_JUMP;
+                    pc.count = 1;
+                    pc.targets[0] = ir_target(TG_LABEL, tail);
+                    body.push_back(pc);
+                    continue;
+                }
+                
+                if (pc.tag == PIECE_OPERATION && pc.op == OP_JUMP && ir.pieces[inlined.blocks[inlined.labels[ir.pieces[i].targets[0].value]].end - 1].op == OP_RETURN)
+                    pc.targets[0] = ir_target(TG_LABEL, tail);
+                else if (pc.tag == PIECE_OPERATION && pc.op == OP_CALL)
+                    ++calls[pc.targets[0].value];
+                
+                body.push_back(pc);
+            }
+        }
+        
+        // The tail of the split block, its successors' phis now coming from the
+        //   block it ends up in
+        piece& last = body.back();
+        bool merge = returned.size() == 1 && last.tag == PIECE_OPERATION && last.op == OP_JUMP && last.targets[0].value == tail;
+        
+        if (merge)
+        {
+            body.pop_back();
+            tail = returned[0].second;
+        }
+        else
+        {
+            piece pc;
+            pc.tag = PIECE_LABEL;
+            pc.op = 0;
+            pc.count = 1;
+            pc.targets[0] = ir_target(TG_LABEL, tail);
+            body.push_back(pc);
+            
+            for (unsigned int i = 0; i < returned.size() && result >= 0; ++i)
+            {
+                pc.tag = PIECE_OPERATION;
+                pc.op = OP_PHI;
+                pc.count = 3;
+                pc.targets[0] = ir_target(TG_REGISTER, result);
+                pc.targets[1] = returned[i].first;
+                pc.targets[2] = ir_target(TG_LABEL, returned[i].second);
+                body.push_back(pc);
+            }
+        }
+        
+        int rest = body.size();
+        body.insert(body.end(), ir.pieces.begin() + call + (result >= 0 ? 2 : 1), ir.pieces.begin() + f.end);
+        
+        inline_rename_preds(body, 0, head_end, split, tail);
+        inline_rename_preds(body, rest, body.size(), split, tail);
+        
+        // Without a phi, the returned value is used directly
+        if (merge && result >= 0)
+        {
+            for (unsigned int i = 0; i < body.size(); ++i)
+            {
+                piece& pc = body[i];
+                if (pc.tag != PIECE_OPERATION)
+                    continue;
+                
+                for (int j = ir_defines(pc) ? 1 : 0; j < pc.count; ++j)
+                    if (pc.targets[j].tag == TG_REGISTER && pc.targets[j].value == result)
+                        pc.targets[j] = returned[0].first;
+            }
+        }
+        
+        f.registers += g.registers - count + extra;
+        
+        ir_graph_free(inlined);
+        ir_replace(ir, fun, body);
+        
+        return calls;
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    int inline_cost(ir_program& ir, int fun)
+    {
+        ir_function& f = ir.functions[fun];
+        if (!f.lowered || !f.ssa)
+            return -1;
+        
+        ir_graph graph = ir_graph_create(ir, fun);
+        int size = 0;
+        bool exits = false;
+        
+        if (graph.blocks.empty() || graph.blocks[0].pred_begin != graph.blocks[0].pred_end)
+            size = -1;
+        
+        for (unsigned int bl = 0; bl < graph.blocks.size() && size >= 0; ++bl)
+        {
+            ir_block& block = graph.blocks[bl];
+            piece& last = ir.pieces[block.end - 1];
+            
+            if (last.op == OP_RETURN)
+            {
+                if (block.end - block.begin != 2 || !bl)
+                    size = -1;
+                exits = true;
+                continue;
+            }
+            
+            bool returns = last.op == OP_TAIL_CALL;
+            exits = exits || returns;
+            for (int i = block.begin; i < block.end; ++i)
+            {
+                piece& pc = ir.pieces[i];
+                if (pc.tag != PIECE_OPERATION || pc.op == OP_JUMP)
+                    continue;
+                
+                if (pc.op == OP_POP_RET)
+                    returns = true;
+                else
+                    ++size;
+            }
+            
+            if (last.op == OP_TAIL_CALL)
+                continue;
+            
+            int target = graph.labels[last.targets[0].value];
+            if (ir.pieces[graph.blocks[target].end - 1].op == OP_RETURN && !returns)
+                size = -1;
+        }
+        
+        ir_graph_free(graph);
+        return exits ? size : -1;
+    }
+    
+    int inline_run(ir_program& ir, call_graph& graph)
+    {
+        std::vector<bool> removable = dce_removable_calls(ir, graph);
+        
+        // The component of each function, and the call sites of each callee
+        std::vector<int> scc(ir.functions.size(), -1);
+        std::vector<int> sites(ir.functions.size(), 0);
+        
+        for (unsigned int i = 0; i < ir.functions.size(); ++i)
+        {
+            ir_function& f = ir.functions[i];
+            
+            std::map<function*, int>::iterator it = graph.index.find(f.fun);
+            if (it != graph.index.end())
+                scc[i] = graph.nodes[it->second].scc;
+            
+            if (!f.lowered)
+                continue;
+            
+            for (int j = f.begin; j < f.end; ++j)
+                if (ir.pieces[j].tag == PIECE_OPERATION && (ir.pieces[j].op == OP_CALL || ir.pieces[j].op == OP_TAIL_CALL))
+                    ++sites[ir.pieces[j].targets[0].value];
+        }
+        
+        std::vector<bool> recursive(graph.sccs.size());
+        for (unsigned int c = 0; c < graph.sccs.size(); ++c)
+            recursive[c] = call_graph_is_recursive(graph, c);
+        
+        int inlined = 0;
+        for (unsigned int c = 0; c < graph.sccs.size(); ++c)
+        {
+            for (unsigned int k = 0; k < graph.sccs[c].size(); ++k)
+            {
+                std::map<function*, int>::iterator it = ir.index.find(graph.nodes[graph.sccs[c][k]].fun);
+                if (it == ir.index.end() || !ir.functions[it->second].lowered || !ir.functions[it->second].ssa)
+                    continue;
+                
+                int fun = it->second;
+                bool changed = false;
+                
+                // Scan the calls, resuming at the inlined body after each inlining
+                for (int i = 0; i < ir.functions[fun].end - ir.functions[fun].begin; ++i)
+                {
+                    ir_function& f = ir.functions[fun];
+                    piece& pc = ir.pieces[f.begin + i];
+                    if (pc.tag != PIECE_OPERATION || pc.op != OP_CALL)
+                        continue;
+                    
+                    int callee = pc.targets[0].value;
+                    int count = pc.targets[1].value;
+                    if (scc[callee] >= 0 && (scc[callee] == scc[fun] || recursive[scc[callee]]))
+                        continue;
+                    
+                    int size = inline_cost(ir, callee);
+                    if (size < 0 || f.end - f.begin + size > INLINE_MAX_CALLER_SIZE)
+                        continue;
+                    
+                    int threshold = INLINE_BASE_SIZE + count;
+                    for (int j = f.begin + i - count; j < f.begin + i; ++j)
+                        if (ir.pieces[j].targets[0].tag == TG_CONSTANT)
+                            threshold += INLINE_CONSTANT_BONUS;
+                    
+                    if (sites[callee] == 1)
+                        threshold = std::max(threshold, INLINE_SINGLE_SITE_SIZE);
+                    
+                    if (size > threshold)
+                        continue;
+                    
+                    std::vector<int> calls = inline_call(ir, fun, f.begin + i);
+                    for (unsigned int j = 0; j < calls.size(); ++j)
+                        sites[j] += calls[j];
+                    --sites[callee];
+                    
+                    ++inlined;
+                    changed = true;
+                    i -= count + 1;
+                }
+                
+                if (changed)
+                {
+                    sccp_run(ir, fun);
+                    gvn_run(ir, fun);
+                    dce_run(ir, fun, removable);
+                }
+            }
+        }
+        
+        return inlined;
+    }
+}
@@ -0,0 +1,553 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_ir.h"
+#include "nut/sem_cfg.h"
+#include <stdexcept>
+
+namespace sem
+{
+    using namespace pr;
+    
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! The state of a function lowering.
+    //!
+    //! ir:      the program's IR, that pieces are appended to
+    //! objects: the variable indices, by IDENTIFIER_EXPR node
+    struct ir_builder
+    {
+        ir_program* ir;
+        std::map<ast_node*, int> objects;
+    };
+    
+    //! Append a piece, with up to two targets.
+    static void ir_emit(ir_builder& b, int tag, int op, int count = 0, target first = target(), target second = target())
+    {
+        piece pc;
+        pc.tag = tag;
+        pc.op = op;
+        pc.count = count;
+        pc.targets[0] = first;
+        pc.targets[1] = second;
+        b.ir->pieces.push_back(pc);
+    }
+    
+    //! Append an operation.
+    static void ir_emit_op(ir_builder& b, int op)
+    {
+        ir_emit(b, PIECE_OPERATION, op);
+    }
+    
+    static void ir_emit_op(ir_builder& b, int op, target tg)
+    {
+        ir_emit(b, PIECE_OPERATION, op, 1, tg);
+    }
+    
+    //! Get the object target of a variable's IDENTIFIER_EXPR node.
+    static target ir_object(ir_builder& b, ast_node* node)
+    {
+        std::map<ast_node*, int>::iterator it = b.objects.find(node);
+        if (it == b.objects.end())
+            throw std::logic_error(std::string("ir_lower: unresolved identifier '") + node->as_identifier_expr->name + "'");
+        
+        return ir_target(TG_OBJECT, it->second);
+    }
+    
+    //! Lower a call expression, pushing its result if value is true.
+    static void ir_lower_call(ir_builder& b, ast_node* node, bool value);
+    
+    //! Lower an expression.
+    //! Its result is pushed onto the stack if value is true, otherwise it is
+    //!   only evaluated for its side effects.
+    static void ir_lower_expr(ir_builder& b, ast_node* node, bool value)
+    {
+        switch (node->tag)
+        {
+            case EXPRESSION:
+                ir_lower_expr(b, node->children[0], value);
+                return;
+            
+            case INTEGER_LITERAL_EXPR:
+                if (value)
+                    ir_emit_op(b, OP_PUSH, ir_target(TG_CONSTANT, node->as_integer_literal_expr->value));
+                return;
+            
+            case IDENTIFIER_EXPR:
+                if (value)
+                    ir_emit_op(b, OP_PUSH, ir_object(b, node));
+                return;
+            
+            case FUNCTION_CALL_EXPR:
+                ir_lower_call(b, node, value);
+                return;
+            
+            case INC_EXPR:
+            case DEC_EXPR:
+            {
+                target object = ir_object(b, node->children[0]);
+                
+                ir_emit_op(b, OP_PUSH, object);
+                ir_emit_op(b, OP_PUSH, ir_target(TG_CONSTANT, 1));
+                ir_emit_op(b, node->tag == INC_EXPR ? OP_ADD : OP_SUB);
+                ir_emit_op(b, OP_POP, object);
+                
+                if (value)
+                    ir_emit_op(b, OP_PUSH, object);
+                return;
+            }
+            
+            case ASSIGNMENT_EXPR:
+            {
+                target object = ir_object(b, node->children[0]);
+                
+                ir_lower_expr(b, node->children[1], true);
+                ir_emit_op(b, OP_POP, object);
+                
+                if (value)
+                    ir_emit_op(b, OP_PUSH, object);
+                return;
+            }
+            
+            //! Only the right operand of a comma gives the result.
+            case LIST_EXPR:
+                ir_lower_expr(b, node->children[0], false);
+                ir_lower_expr(b, node->children[1], value);
+                return;
+            
+            case NEG_EXPR:
+            case NOT_EXPR:
+                ir_lower_expr(b, node->children[0], true);
+                ir_emit_op(b, node->tag == NEG_EXPR ? OP_NEG : OP_NOT);
+                break;
+            
+            case ADD_EXPR:
+            case SUB_EXPR:
+            case MUL_EXPR:
+            case DIV_EXPR:
+                ir_lower_expr(b, node->children[0], true);
+                ir_lower_expr(b, node->children[1], true);
+                
+                switch (node->tag)
+                {
+                    case ADD_EXPR: ir_emit_op(b, OP_ADD); break;
+                    case SUB_EXPR: ir_emit_op(b, OP_SUB); break;
+                    case MUL_EXPR: ir_emit_op(b, OP_MUL); break;
+                    case DIV_EXPR: ir_emit_op(b, OP_DIV); break;
+                }
+                break;
+            
+            default:
+                throw std::logic_error("ir_lower: unexpected expression node");
+        }
+        
+        // Drop the unused result of an operation
+        if (!value)
+            ir_emit_op(b, OP_POP);
+    }
+    
+    static void ir_lower_call(ir_builder& b, ast_node* node, bool value)
+    {
+        std::map<ast_node*, function*>::iterator it = b.ir->callees.find(node);
+        if (it == b.ir->callees.end())
+            throw std::logic_error("ir_lower: unresolved call");
+        
+        function* callee = it->second;
+        
+        std::vector<ast_node*> args;
+        ast_call_arguments(node, args);
+        
+        for (unsigned int i = 0; i < args.size(); ++i)
+            ir_lower_expr(b, args[i], true);
+        
+        ir_emit(b, PIECE_OPERATION, OP_CALL, 2,
+                ir_target(TG_FUNCTION, b.ir->index[callee]),
+                ir_target(TG_CONSTANT, args.size()));
+        
+        if (value && !(callee->ret_tp->flags & TYPE_FLAG_NONCOPYABLE))
+            ir_emit_op(b, OP_PUSH_RET);
+    }
+    
+    //! Lower a statement of a basic block.
+    static void ir_lower_stmt(ir_builder& b, ast_node* node)
+    {
+        switch (node->tag)
+        {
+            case DECLARATION_STMT:
+                if (node->children.size() < 2)
+                    return;
+                
+                ir_lower_expr(b, node->children[1], true);
+                ir_emit_op(b, OP_POP, ir_target(TG_OBJECT, node->decl->as_variable->index));
+                return;
+            
+            //! The jump to the exit block ends the basic block.
+            case RETURN_STMT:
+                if (node->children.empty())
+                    return;
+                
+                ir_lower_expr(b, node->children[0], true);
+                ir_emit_op(b, OP_POP_RET);
+                return;
+            
+            default:
+                ir_lower_expr(b, node, false);
+                return;
+        }
+    }
+    
+    //! Print a target.
+    static void ir_dump_target(ir_program& ir, ir_function& f, target const& tg, std::ostream& os)
+    {
+        switch (tg.tag)
+        {
+            case TG_CONSTANT:
+                os << tg.value;
+                break;
+            
+            case TG_LABEL:
+                os << "L" << tg.value;
+                break;
+            
+            case TG_OBJECT:
+                os << f.fun->variables[tg.value]->name;
+                break;
+            
+            case TG_FUNCTION:
+                os << ir.functions[tg.value].fun->name;
+                break;
+            
+            case TG_REGISTER:
+                os << "%" << tg.value;
+                break;
+        }
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    ir_program ir_create(ast_node* program)
+    {
+        ir_program ir;
+        
+        for (unsigned int i = 0; i < program->children.size(); ++i)
+        {
+            ast_node* node = program->children[i];
+            if (!node->decl)
+                continue;
+            
+            ir_function f;
+            f.fun = node->decl->as_function;
+            f.node = node;
+            f.lowered = false;
+            f.begin = f.end = 0;
+            f.ssa = false;
+            f.registers = 0;
+            
+            ir.index[f.fun] = ir.functions.size();
+            ir.functions.push_back(f);
+        }
+        
+        for (unsigned int i = 0; i < ir.functions.size(); ++i)
+        {
+            function* fun = ir.functions[i].fun;
+            for (unsigned int j = 0; j < fun->uses.size(); ++j)
+                ir.callees[fun->uses[j]] = fun;
+        }
+        
+        return ir;
+    }
+    
+    void ir_free(ir_program& ir)
+    {
+        ir.pieces.clear();
+        ir.functions.clear();
+        ir.index.clear();
+        ir.callees.clear();
+    }
+    
+    void ir_lower(ir_program& ir, int fun)
+    {
+        ir_function& f = ir.functions[fun];
+        
+        ir_builder b;
+        b.ir = &ir;
+        
+        for (unsigned int i = 0; i < f.fun->variables.size(); ++i)
+        {
+            variable* var = f.fun->variables[i];
+            for (unsigned int j = 0; j < var->uses.size(); ++j)
+                b.objects[var->uses[j]] = var->index;
+        }
+        
+        // Each reachable block of the control-flow graph is labelled with its
+        //   identifier, the exit block (the last one in reverse post-order) returns
+        cfg graph = cfg_create(f.node);
+        
+        f.begin = ir.pieces.size();
+        
+        for (unsigned int rpo = 0; rpo < graph.rpo.size(); ++rpo)
+        {
+            int block = graph.rpo[rpo];
+            cfg_block& bb = graph.blocks[block];
+            
+            ir_emit(b, PIECE_LABEL, 0, 1, ir_target(TG_LABEL, block));
+            
+            for (int s = bb.stmt_begin; s < bb.stmt_end; ++s)
+                ir_lower_stmt(b, graph.stmts[s]);
+            
+            if (block == CFG_EXIT)
+                ir_emit_op(b, OP_RETURN);
+            else
+                ir_emit_op(b, OP_JUMP, ir_target(TG_LABEL, graph.succs[bb.succ_begin]));
+        }
+        
+        f.end = ir.pieces.size();
+        f.labels.assign(graph.blocks.size(), -1);
+        f.lowered = true;
+        
+        cfg_free(graph);
+        
+        ir_resolve_labels(ir, fun);
+    }
+    
+    void ir_replace(ir_program& ir, int fun, std::vector<piece> const& body)
+    {
+        ir_function& f = ir.functions[fun];
+        f.begin = ir.pieces.size();
+        ir.pieces.insert(ir.pieces.end(), body.begin(), body.end());
+        f.end = ir.pieces.size();
+        
+        // Compact the buffer when the replaced bodies take most of it,
+        //   moving the functions in order
+        unsigned int live = 0;
+        for (unsigned int i = 0; i < ir.functions.size(); ++i)
+            live += ir.functions[i].end - ir.functions[i].begin;
+        
+        bool compact = ir.pieces.size() > 2 * live;
+        if (compact)
+        {
+            std::vector<piece> pieces;
+            pieces.reserve(live);
+            
+            for (unsigned int i = 0; i < ir.functions.size(); ++i)
+            {
+                ir_function& g = ir.functions[i];
+                int begin = pieces.size();
+                pieces.insert(pieces.end(), ir.pieces.begin() + g.begin, ir.pieces.begin() + g.end);
+                g.begin = begin;
+                g.end = pieces.size();
+            }
+            
+            ir.pieces.swap(pieces);
+        }
+        
+        // Labels are resolved to offsets, that moved if the buffer was compacted
+        for (unsigned int i = 0; i < ir.functions.size(); ++i)
+            if (ir.functions[i].lowered && (compact || (int) i == fun))
+                ir_resolve_labels(ir, i);
+    }
+    
+    void ir_resolve_labels(ir_program& ir, int fun)
+    {
+        ir_function& f = ir.functions[fun];
+        f.labels.assign(f.labels.size(), -1);
+        
+        for (int i = f.begin; i < f.end; ++i)
+        {
+            piece& pc = ir.pieces[i];
+            if (pc.tag != PIECE_LABEL)
+                continue;
+            
+            int id = pc.targets[0].value;
+            if (id >= (int) f.labels.size())
+                f.labels.resize(id + 1, -1);
+            
+            if (f.labels[id] >= 0)
+                throw std::logic_error("ir_resolve_labels: label placed twice in '" + f.fun->name + "'");
+            f.labels[id] = i;
+        }
+        
+        for (int i = f.begin; i < f.end; ++i)
+        {
+            piece& pc = ir.pieces[i];
+            if (pc.tag != PIECE_OPERATION)
+                continue;
+            
+            for (int j = 0; j < pc.count; ++j)
+            {
+                target& tg = pc.targets[j];
+                if (tg.tag == TG_LABEL && (tg.value >= (int) f.labels.size() || f.labels[tg.value] < 0))
+                    throw std::logic_error("ir_resolve_labels: label used but not placed in '" + f.fun->name + "'");
+            }
+        }
+    }
+    
+    ir_graph ir_graph_create(ir_program& ir, int fun)
+    {
+        ir_function& f = ir.functions[fun];
+        
+        ir_graph graph;
+        graph.fun = fun;
+        graph.labels.assign(f.labels.size(), -1);
+        
+        // Split the code at labels, each block ending with its jump
+        std::vector<std::vector<int> > succs;
+        for (int i = f.begin; i < f.end; ++i)
+        {
+            piece& pc = ir.pieces[i];
+            
+            if (pc.tag == PIECE_LABEL)
+            {
+                ir_block block;
+                block.begin = block.end = i;
+                block.rpo = -1;
+                
+                graph.labels[pc.targets[0].value] = graph.blocks.size();
+                graph.blocks.push_back(block);
+                succs.push_back(std::vector<int>());
+            }
+            
+            graph.blocks.back().end = i + 1;
+        }
+        
+        for (unsigned int b = 0; b < graph.blocks.size(); ++b)
+        {
+            piece& last = ir.pieces[graph.blocks[b].end - 1];
+            if (last.tag == PIECE_OPERATION && last.op == OP_JUMP)
+                succs[b].push_back(graph.labels[last.targets[0].value]);
+        }
+        
+        // Flatten the edges, the predecessors being counted first
+        int n = graph.blocks.size();
+        std::vector<int> pred_count(n, 0);
+        for (int b = 0; b < n; ++b)
+            for (unsigned int j = 0; j < succs[b].size(); ++j)
+                ++pred_count[succs[b][j]];
+        
+        for (int b = 0, preds = 0; b < n; ++b)
+        {
+            ir_block& block = graph.blocks[b];
+            
+            block.succ_begin = graph.succs.size();
+            graph.succs.insert(graph.succs.end(), succs[b].begin(), succs[b].end());
+            block.succ_end = graph.succs.size();
+            
+            block.pred_begin = block.pred_end = preds;
+            preds += pred_count[b];
+        }
+        
+        graph.preds.resize(graph.succs.size());
+        for (int b = 0; b < n; ++b)
+            for (unsigned int j = 0; j < succs[b].size(); ++j)
+                graph.preds[graph.blocks[succs[b][j]].pred_end++] = b;
+        
+        // Number the reachable blocks in reverse post-order (iteratively,
+        //   as in sem_cfg.cpp)
+        std::vector<int> post;
+        if (n)
+        {
+            std::vector<bool> visited(n, false);
+            std::vector<std::pair<int, int> > dfs;
+            dfs.push_back(std::make_pair(0, graph.blocks[0].succ_begin));
+            visited[0] = true;
+            
+            while (dfs.size())
+            {
+                int block = dfs.back().first;
+                int succ = dfs.back().second;
+                
+                if (succ < graph.blocks[block].succ_end)
+                {
+                    ++dfs.back().second;
+                    
+                    int next = graph.succs[succ];
+                    if (!visited[next])
+                    {
+                        visited[next] = true;
+                        dfs.push_back(std::make_pair(next, graph.blocks[next].succ_begin));
+                    }
+                }
+                else
+                {
+                    post.push_back(block);
+                    dfs.pop_back();
+                }
+            }
+        }
+        
+        graph.rpo.assign(post.rbegin(), post.rend());
+        for (unsigned int i = 0; i < graph.rpo.size(); ++i)
+            graph.blocks[graph.rpo[i]].rpo = i;
+        
+        return graph;
+    }
+    
+    void ir_graph_free(ir_graph& graph)
+    {
+        graph.blocks.clear();
+        graph.succs.clear();
+        graph.preds.clear();
+        graph.rpo.clear();
+        graph.labels.clear();
+    }
+    
+    void ir_dump(ir_program& ir, std::ostream& os)
+    {
+        static char const* const names[] =
+        {
+            "push", "pop",
+            "pop_ret", "push_ret", "call",
+            "add", "sub", "mul", "div", "neg", "not",
+            "jump", "return",
+            "phi",
+            "tail_call"
+        };
+        
+        for (unsigned int i = 0; i < ir.functions.size(); ++i)
+        {
+            ir_function& f = ir.functions[i];
+            if (!f.lowered || !f.node)
+                continue;
+            
+            os << f.fun->name << ":" << std::endl;
+            
+            for (int j = f.begin; j < f.end; ++j)
+            {
+                piece& pc = ir.pieces[j];
+                
+                if (pc.tag == PIECE_LABEL)
+                {
+                    os << "  L" << pc.targets[0].value << ":" << std::endl;
+                    continue;
+                }
+                
+                os << "    " << names[pc.op];
+                for (int k = 0; k < pc.count; ++k)
+                {
+                    os << (k ? ", " : " ");
+                    ir_dump_target(ir, f, pc.targets[k], os);
+                }
+                os << std::endl;
+            }
+        }
+    }
+}
@@ -18,9 +18,29 @@
 
 #include "nut/sem_passman.h"
 #include "nut/sem_declarator.h"
+#include "nut/sem_types.h"
+#include "nut/sem_context.h"
+#include "nut/sem_workers.h"
+#include "nut/sem_cfg.h"
+#include "nut/sem_dataflow.h"
+#include "nut/sem_callgraph.h"
+#include "nut/sem_purity.h"
+#include "nut/sem_eval.h"
+#include "nut/sem_ssa.h"
+#include "nut/sem_sccp.h"
+#include "nut/sem_gvn.h"
+#include "nut/sem_dce.h"
+#include "nut/sem_inline.h"
+#include "nut/sem_tail.h"
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
-#include <iostream> // for std::cerr
+#include <iostream>
+#include <exception>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <set>
 
 namespace sem
 {
@@ -30,70 +50,60 @@ namespace sem
     /*** Private module implementation ***/
     /*************************************/
     
-    passman::passman(pr::parser& par) : par(par)
+    passman::passman(pr::parser& par, context& ctx) : par(par), ctx(ctx), current(0), timing(false), jobs(1), workers(0)
     { }
     
-    //! Generate an (empty) table for the built-in types.
-    #define DECL_BUILTIN_TYPE(name, flags) { },
+    //! Emit a semantic error about a node.
+    //! It is recorded with the current pass diagnostics, and PASS_FAILED is
+    //!   returned for the handler to return it.
+    static int pass_error(passman& pman, ast_node* node, int id,
+                          std::string const& arg0 = "",
+                          std::string const& arg1 = "",
+                          std::string const& arg2 = "")
+    {
+        pman.diags[pman.current].push_back(diag_make(id, node->saved_tok.info.offset, node->saved_tok.length, arg0, arg1, arg2));
+        return PASS_FAILED;
+    }
     
-    type builtin_types[] = {
-        #include "nut/sem_builtins.inc"
-    };
+    //! Emit a semantic warning about a node.
+    //! It is recorded with the current pass diagnostics, that are flushed
+    //!   to the context's sink once the current traversal completes.
+    static void pass_warning(passman& pman, ast_node* node, int id, std::string const& arg0 = "")
+    {
+        pman.diags[pman.current].push_back(diag_make(id, node->saved_tok.info.offset, node->saved_tok.length, arg0));
+    }
     
-    static int builtin_types_size = sizeof(builtin_types) / sizeof(type);
+    //! Create a variable declarator, on behalf of the current pass.
+    static variable* pass_variable_create(passman& pman, std::string const& name)
+    {
+        ++pman.passes[pman.current].stats.declarators;
+        return variable_create(pman.ctx.variables, name);
+    }
     
-    #undef DECL_BUILTIN_TYPE
+    //! Create count contiguous variable declarators, on behalf of the current pass.
+    static variable* pass_variables_create(passman& pman, int count)
+    {
+        pman.passes[pman.current].stats.declarators += count;
+        return variables_create(pman.ctx.variables, count);
+    }
     
-    //! Find a built-in type by name.
-    //! Returns 0 if not found.
-    static type* find_builtin_type(std::string const& name)
+    //! Create a function declarator, on behalf of the current pass.
+    static function* pass_function_create(passman& pman, std::string const& name)
     {
-        static bool inited = false;
-        if (!inited)
-        {
-            int i = 0;
-            type* tp;
-            
-            #define DECL_BUILTIN_TYPE(nm, fl) \
-                tp = builtin_types + i++; \
-                tp->tag = TYPE_DECLARATOR; \
-                tp->name = #nm; \
-                tp->self = tp; \
-                tp->flags = fl;
-            
-            #include "nut/sem_builtins.inc"
-            
-            #undef DECL_BUILTIN_TYPE
-            
-            inited = true;
-        }
-        
-        for (int i = 0; i < builtin_types_size; ++i)
-            if (builtin_types[i].name == name)
-                return builtin_types + i;
-        
-        return 0;
+        ++pman.passes[pman.current].stats.declarators;
+        return function_create(pman.ctx.functions, name);
     }
     
-    //! Emit a semantic error about a node.
-    //! This throws an exception with the associated line and column.
-    static void pass_error(passman& pman, ast_node* node, std::string const& msg)
+    //! Record a node referencing a declarator.
+    static void pass_record_use(passman& pman, declarator* decl, ast_node* node)
     {
-        std::ostringstream ss;
-        ss << "semantic error: " << parser_token_information(node->saved_tok) << msg << std::endl;
-        ss << parser_error_line(pman.par, node->saved_tok);
-        throw std::logic_error(ss.str());
+        pman.uses.push_back(std::make_pair(decl, node));
     }
     
-    //! Emit a semantic warning about a node.
-    //! This prints to stderr with the associated line and column.
-    static void pass_warning(passman& pman, ast_node* node, std::string const& msg)
+    //! Record a call made by a function.
+    static void pass_record_call(passman& pman, function* caller, ast_node* call)
     {
-        std::ostringstream ss;
-        ss << "warning: " << parser_token_information(node->saved_tok) << msg << std::endl;
-        ss << parser_error_line(pman.par, node->saved_tok);
-        
-        std::cerr << ss.str() << std::endl;
+        pman.calls.push_back(std::make_pair(caller, call));
     }
     
     //! Resolve a declarator in the node's subtree.
@@ -113,24 +123,36 @@ namespace sem
         return 0;
     }
     
-    //! Resolve a declarator by name in the AST.
+    //! Resolve a declarator by name in the AST, then in the imported functions.
     //! Returns the first declarator whose name is matching
     //!   regardless of its type.
+    //! The bodies of the other functions are never searched (LOCAL passes may be
+    //!   changing them concurrently) : functions are found by name in the
+    //!   context's index.
     //! Returns 0 if not found.
     //WARNING: this has exponential run time in AST depth
     //         because it calls resolve_inner_declarator on each node, then on node->parent
     //         so each tree is examined multiple times :/
-    static declarator* resolve_declarator(std::string const& name, ast_node* node)
+    static declarator* resolve_declarator(passman& pman, std::string const& name, ast_node* node)
     {
-        type* builtin = find_builtin_type(name);
+        type* builtin = type_table_find(pman.ctx.types, name);
         if (builtin)
             return builtin;
         
         if (!node)
-            return 0;
+            return summary_find(pman.ctx.imports, name);
         
-        // Search in previous nodes (including this one)
-        for (ast_node* it = node; it; it = it->prev)
+        if (node->tag == PROGRAM_DECL)
+        {
+            std::map<std::string, function*>::iterator it = pman.ctx.globals.find(name);
+            if (it != pman.ctx.globals.end())
+                return it->second;
+            
+            return resolve_declarator(pman, name, node->parent);
+        }
+        
+        // Search in previous nodes (including this one), up to the previous function
+        for (ast_node* it = node; it && (it == node || it->tag != FUNCTION_DECL); it = it->prev)
         {
             declarator* decl = resolve_inner_declarator(name, it);
             if (decl)
@@ -143,13 +165,13 @@ namespace sem
             if (!node->decl) throw std::runtime_error("sem::resolve_declarator: internal error: null declarator");
             function* fun = node->decl->as_function;
             
-            for (unsigned int i = 0; i < fun->arguments.size(); ++i)
-                if (fun->arguments[i]->name == name)
-                    return fun->arguments[i];
+            for (int i = 0; i < fun->argument_count; ++i)
+                if (fun->arguments[i].name == name)
+                    return &fun->arguments[i];
         }
         
         // Search in the node's parent, if null returns 0
-        return resolve_declarator(name, node->parent);
+        return resolve_declarator(pman, name, node->parent);
     }
     
     //! Resolve the current function declarator.
@@ -164,31 +186,11 @@ namespace sem
         return resolve_function_declarator(node->parent);
     }
     
-    /*************************/
-    /*** Public module API ***/
-    /*************************/
-    
-    passman passman_create(pr::parser& par)
-    {
-        passman pman(par);
-        return pman;
-    }
-
-    void passman_free(passman&)
-    { }
-    
-    void passman_run_all(passman& pman, pr::ast_node* node)
-    {
-        pass_fix_ast(pman, node);
-        pass_create_declarators(pman, node);
-        pass_check_calls(pman, node);
-        pass_resolve_result_types(pman, node);
-        pass_type_check(pman, node);
-        pass_unused_expression_results(pman, node);
-        pass_unreachable_code(pman, node);
-    }
+    /*********************/
+    /*** Pass handlers ***/
+    /*********************/
     
-    void pass_fix_ast(passman& pman, ast_node* node)
+    static int fix_ast_enter(passman&, ast_node* node)
     {
         int n = (int) node->children.size();
         
@@ -204,13 +206,13 @@ namespace sem
             // Patch next pointer if not last
             if (i != n-1)
                 child->next = node->children[i+1];
-            
-            // Fix this node's subtree
-            pass_fix_ast(pman, child);
         }
+        
+        // Then fix the children's subtrees
+        return PASS_VISIT_ALL;
     }
     
-    void pass_create_declarators(passman& pman, ast_node* node)
+    static int create_declarators_enter(passman& pman, ast_node* node)
     {
         switch (node->tag)
         {
@@ -219,8 +221,16 @@ namespace sem
                 declaration_stmt_node* stmt = node->as_declaration_stmt;
                 
                 // Create a declarator with the appropriate name and type
-                variable* var = variable_create(stmt->name);
-                var->tp = resolve_declarator(stmt->children[0]->as_type_specifier->name, stmt)->as_type;
+                variable* var = pass_variable_create(pman, stmt->name);
+                var->tp = resolve_declarator(pman, stmt->children[0]->as_type_specifier->name, stmt)->as_type;
+                
+                // And index it in its function
+                function* fun = resolve_function_declarator(node);
+                if (fun)
+                {
+                    var->index = fun->variables.size();
+                    fun->variables.push_back(var);
+                }
                 
                 node->decl = var;
                 break;
@@ -228,12 +238,14 @@ namespace sem
             
             case ARGUMENT:
             {
-                argument_node* arg = node->as_argument;
+                // Arguments declarators are created with their function (visited first),
+                //   so that the uses of an argument are recorded in the function's arguments
+                ast_node* fun_node = node->parent->parent;
+                function* fun = fun_node->decl->as_function;
                 
-                variable* var = variable_create(arg->name);
-                var->tp = resolve_declarator(arg->children[0]->as_type_specifier->name, arg)->as_type;
-                
-                node->decl = var;
+                for (int i = 0; i < fun->argument_count; ++i)
+                    if (fun_node->children[1]->children[i] == node)
+                        node->decl = &fun->arguments[i];
                 break;
             }
             
@@ -245,51 +257,66 @@ namespace sem
                 argument_list_node* stmt_args = stmt->children[1]->as_argument_list;
                 
                 // Create a declarator with the appropriate name and type
-                function* fun = function_create(stmt->name);
-                fun->ret_tp = resolve_declarator(stmt_ret_tp->name, stmt)->as_type;
+                function* fun = pass_function_create(pman, stmt->name);
+                fun->ret_tp = resolve_declarator(pman, stmt_ret_tp->name, stmt)->as_type;
                 
                 // Create arguments specifications
-                for (unsigned int i = 0; i < stmt_args->children.size(); ++i)
+                int count = stmt_args->children.size();
+                std::vector<type*> args_tp;
+                
+                fun->arguments = count ? pass_variables_create(pman, count) : 0;
+                fun->argument_count = count;
+                
+                for (int i = 0; i < count; ++i)
                 {
                     argument_node* stmt_arg = stmt_args->children[i]->as_argument;
                     
-                    variable* arg = variable_create(stmt_arg->name);
-                    arg->tp = resolve_declarator(stmt_arg->children[0]->as_type_specifier->name, stmt_arg)->as_type;
-                    fun->arguments.push_back(arg);
+                    variable* arg = &fun->arguments[i];
+                    arg->name = stmt_arg->name;
+                    arg->index = i;
+                    fun->variables.push_back(arg);
+                    arg->tp = resolve_declarator(pman, stmt_arg->children[0]->as_type_specifier->name, stmt_arg)->as_type;
+                    args_tp.push_back(arg->tp);
                 }
                 
+                // And get the canonical function type
+                fun->tp = type_table_function(pman.ctx.types, fun->ret_tp, args_tp);
+                
                 node->decl = fun;
+                pman.ctx.globals.insert(std::make_pair(stmt->name, fun));
                 break;
             }
         }
         
-        for (unsigned int i = 0; i < node->children.size(); ++i)
-            pass_create_declarators(pman, node->children[i]);
+        return PASS_VISIT_ALL;
     }
-
-    void pass_check_calls(passman& pman, ast_node* node)
+    
+    static int check_calls_enter(passman& pman, ast_node* node)
     {
         if (node->tag == FUNCTION_CALL_EXPR)
         {
             // Check if the called object is an identifier
             ast_node* id = node->children[0];
             if (id->tag != IDENTIFIER_EXPR)
-                pass_error(pman, node, "function calls are only supported on identifiers");
+                return pass_error(pman, node, DIAG_CALL_NOT_IDENTIFIER);
             std::string name = id->as_identifier_expr->name;
             
             // Get the associated declarator
-            declarator* fun = resolve_declarator(name, node);
+            declarator* fun = resolve_declarator(pman, name, node);
             
             // This is an internal error, because the parser already checks for
             //   uses of undeclared identifiers
             if (!fun) throw std::runtime_error("sem::pass_check_calls: internal error: declarator not found");
             
+            pass_record_use(pman, fun, node);
+            pass_record_call(pman, resolve_function_declarator(node), node);
+            
             // Check if the resolved object is a function
             if (fun->tag != FUNCTION_DECLARATOR)
-                pass_error(pman, node, "'" + name + "' is not a function");
+                return pass_error(pman, node, DIAG_NOT_A_FUNCTION, name);
             
             // Number of arguments that the function expects
-            int arity = fun->as_function->arguments.size();
+            int arity = fun->as_function->argument_count;
             
             // Count the number of given arguments
             int call_arity = 0;
@@ -309,62 +336,68 @@ namespace sem
             // Check the arity of the call
             if (call_arity != arity)
             {
-                std::ostringstream ss;
-                
-                ss << "'" << name << "' expects " << arity << " arguments ";
-                ss << "(" << call_arity << " given)";
+                std::ostringstream expected, given;
+                expected << arity;
+                given << call_arity;
                 
-                pass_error(pman, node, ss.str());
+                return pass_error(pman, node, DIAG_CALL_ARITY, name, expected.str(), given.str());
             }
         }
         
-        for (unsigned int i = 0; i < node->children.size(); ++i)
-            pass_check_calls(pman, node->children[i]);
+        return PASS_VISIT_ALL;
+    }
+    
+    static int resolve_result_types_enter(passman&, ast_node* node)
+    {
+        //! The called identifier of a function call is not an expression
+        //!   by itself, so only generate type information for the arguments.
+        if (node->tag == FUNCTION_CALL_EXPR)
+            return 1;
+        
+        return PASS_VISIT_ALL;
     }
     
-    void pass_resolve_result_types(passman& pman, pr::ast_node* node)
+    static int resolve_result_types_leave(passman& pman, ast_node* node)
     {
         switch (node->tag)
         {
             //! The expression node is just a wrapper.
             case EXPRESSION:
-                pass_resolve_result_types(pman, node->children[0]);
                 node->res_tp = node->children[0]->res_tp;
                 break;
             
             //! Trivial for literals.
             case INTEGER_LITERAL_EXPR:
-                node->res_tp = find_builtin_type("int");
+                node->res_tp = type_table_builtin(pman.ctx.types, BUILTIN_TYPE_int);
                 break;
-                
+            
             //! For identifiers, find the declarator and
             //!   take the declared type.
             case IDENTIFIER_EXPR:
             {
-                declarator* decl = resolve_declarator(node->as_identifier_expr->name, node);
+                declarator* decl = resolve_declarator(pman, node->as_identifier_expr->name, node);
                 if (!decl) throw std::runtime_error("sem::pass_resolve_result_types: internal error: null declarator");
                 
+                pass_record_use(pman, decl, node);
+                
                 if (decl->tag != VARIABLE_DECLARATOR)
-                    pass_error(pman, node, "invalid use of identifier '" + node->as_identifier_expr->name + "'");
+                    return pass_error(pman, node, DIAG_INVALID_IDENTIFIER_USE, node->as_identifier_expr->name);
                 
                 node->res_tp = decl->as_variable->tp;
                 break;
             }
-                
+            
             // For function calls, find the function declarator
             //   and take its return type
             case FUNCTION_CALL_EXPR:
             {
                 // The declarator is guaranteed to be a function
-                declarator* decl = resolve_declarator(node->children[0]->as_identifier_expr->name, node);
+                declarator* decl = resolve_declarator(pman, node->children[0]->as_identifier_expr->name, node);
                 if (!decl || decl->tag != FUNCTION_DECLARATOR)
                     throw std::runtime_error("sem::pass_resolve_result_types: internal error: invalid call declarator");
                 
                 // Write out expression result's type
                 node->res_tp = decl->as_function->ret_tp;
-                
-                // Don't forget to generate type information for call expressions
-                pass_resolve_result_types(pman, node->children[1]);
                 break;
             }
             
@@ -374,14 +407,8 @@ namespace sem
             case DEC_EXPR:
             case NEG_EXPR:
             case NOT_EXPR:
-            {
-                ast_node* sub_expr = node->children[0];
-                
-                pass_resolve_result_types(pman, sub_expr);
-                
-                node->res_tp = sub_expr->res_tp;
+                node->res_tp = node->children[0]->res_tp;
                 break;
-            }
             
             //! Binary operators that results in the same type than
             //!   their sub-expression.
@@ -392,36 +419,22 @@ namespace sem
             case DIV_EXPR:
             case ASSIGNMENT_EXPR:
             {
-                // Resolve the left hand side sub-expression's result type
-                ast_node* sub_expr = node->children[0];
-                pass_resolve_result_types(pman, sub_expr);
-                type* lhs_res_tp = sub_expr->res_tp;
-                
-                // Resolve the right hand side sub-expression's result type
-                sub_expr = node->children[1];
-                pass_resolve_result_types(pman, sub_expr);
-                type* rhs_res_tp = sub_expr->res_tp;
+                type* lhs_res_tp = node->children[0]->res_tp;
+                type* rhs_res_tp = node->children[1]->res_tp;
                 
                 // Check for compatibility
-                if (lhs_res_tp->name != rhs_res_tp->name)
-                {
-                    std::ostringstream ss;
-                    ss << "operation between incompatible types '";
-                    ss << lhs_res_tp->name << "' and '";
-                    ss << rhs_res_tp->name << "'";
-                    pass_error(pman, node, ss.str());
-                }
+                if (lhs_res_tp != rhs_res_tp)
+                    return pass_error(pman, node, DIAG_INCOMPATIBLE_OPERANDS, lhs_res_tp->name, rhs_res_tp->name);
                 
                 node->res_tp = lhs_res_tp;
+                break;
             }
-            
-            default:
-                for (unsigned int i = 0; i < node->children.size(); ++i)
-                    pass_resolve_result_types(pman, node->children[i]);
         }
+        
+        return PASS_VISIT_NONE;
     }
     
-    void pass_type_check(passman& pman, pr::ast_node* node)
+    static int type_check_enter(passman& pman, ast_node* node)
     {
         switch (node->tag)
         {
@@ -432,19 +445,20 @@ namespace sem
                 
                 // Check for void variable declarations
                 if (decl_tp->flags & TYPE_FLAG_NONCOPYABLE)
-                    pass_error(pman, node, "variable '" + node->as_declaration_stmt->name + "' declared void");
+                    return pass_error(pman, node, DIAG_VOID_VARIABLE, node->as_declaration_stmt->name);
                 
                 // If there is an initialization, check for type incompatibility
                 if (node->children.size() > 1)
                 {
                     type* init_tp = node->children[1]->res_tp;
-                    if (decl_tp->name != init_tp->name)
-                        pass_error(pman, node, "initializing variable with incompatible type '" +  init_tp->name + "'");
+                    if (decl_tp != init_tp)
+                        return pass_error(pman, node, DIAG_INCOMPATIBLE_INITIALIZER, init_tp->name);
                     
                     // Recurse the call in the expression
-                    pass_type_check(pman, node->children[1]);
+                    return 1;
                 }
-                break;
+                
+                return PASS_VISIT_NONE;
             }
             
             case FUNCTION_CALL_EXPR:
@@ -453,20 +467,23 @@ namespace sem
                 //   because other passes checked this up (as well for children[0]
                 //   being an identifier_expr_node)
                 std::string name = node->children[0]->as_identifier_expr->name;
-                function* fun = resolve_declarator(name, node)->as_function;
+                function* fun = resolve_declarator(pman, name, node)->as_function;
                 
                 // It is guaranteed that the argument count matches the function declarator
-                for (int i = 0; i < (int) fun->arguments.size(); ++i)
+                std::vector<ast_node*> args;
+                ast_call_arguments(node, args);
+                
+                for (int i = 0; i < fun->argument_count; ++i)
                 {
-                    ast_node* arg = node->children[1]->children[i];
-                    type* decl_tp = fun->arguments[i]->tp;
+                    ast_node* arg = args[i];
+                    type* decl_tp = fun->arguments[i].tp;
                     type* res_tp = arg->res_tp;
                     
-                    if (decl_tp->name != res_tp->name)
-                        pass_error(pman, arg, "initializing parameter with incompatible type '" + res_tp->name + "'");
+                    if (decl_tp != res_tp)
+                        return pass_error(pman, arg, DIAG_INCOMPATIBLE_PARAMETER, res_tp->name);
                 }
                 
-                break;
+                return PASS_VISIT_NONE;
             }
             
             case RETURN_STMT:
@@ -476,29 +493,28 @@ namespace sem
                 
                 type* tp;
                 if (!node->children.size())
-                    tp = find_builtin_type("void");
+                    tp = type_table_builtin(pman.ctx.types, BUILTIN_TYPE_void);
                 else
                     tp = node->children[0]->res_tp;
                 
-                if (tp->name != fun->ret_tp->name)
+                if (tp != fun->ret_tp)
                 {
                     if (tp->flags & TYPE_FLAG_NONCOPYABLE)
-                        pass_error(pman, node, "this function expects a return value");
+                        return pass_error(pman, node, DIAG_MISSING_RETURN_VALUE);
                     else if (fun->ret_tp->flags & TYPE_FLAG_NONCOPYABLE)
-                        pass_error(pman, node, "this function does not expects a return value");
+                        return pass_error(pman, node, DIAG_UNEXPECTED_RETURN_VALUE);
                     else
-                        pass_error(pman, node, "returning with incompatible type '" + tp->name + "'");
+                        return pass_error(pman, node, DIAG_INCOMPATIBLE_RETURN, tp->name);
                 }
-                break;
+                
+                return PASS_VISIT_NONE;
             }
-            
-            default:
-                for (unsigned int i = 0; i < node->children.size(); ++i)
-                    pass_type_check(pman, node->children[i]);
         }
+        
+        return PASS_VISIT_ALL;
     }
     
-    void pass_unused_expression_results(passman& pman, pr::ast_node* node)
+    static int unused_expression_results_enter(passman& pman, ast_node* node)
     {
         //! Here we search for simple expression statements (including function
         //!   calls).
@@ -514,7 +530,7 @@ namespace sem
                 {
                     identifier_expr_node* id = expr->children[0]->children[0]->as_identifier_expr;
                     // This is guaranteed to success
-                    function* fun = resolve_declarator(id->name, node)->as_function;
+                    function* fun = resolve_declarator(pman, id->name, node)->as_function;
                     
                     // If the function returns a void result
                     if (fun->ret_tp->flags & TYPE_FLAG_NONCOPYABLE)
@@ -522,22 +538,989 @@ namespace sem
                 }
                 
                 if (!warn)
-                    pass_warning(pman, expr, "unused expression result");
+                    pass_warning(pman, expr, DIAG_UNUSED_RESULT);
+            }
+        }
+        
+        return PASS_VISIT_ALL;
+    }
+    
+    static int unreachable_code_enter(passman& pman, ast_node* node)
+    {
+        if (node->tag != FUNCTION_DECL)
+            return PASS_VISIT_ALL;
+        
+        // Warn once per unreachable block, about the jump preceding it
+        cfg graph = cfg_create(node);
+        
+        for (unsigned int i = 0; i < graph.blocks.size(); ++i)
+        {
+            cfg_block& block = graph.blocks[i];
+            if (!cfg_reachable(graph, i) && block.stmt_begin != block.stmt_end && block.after)
+                pass_warning(pman, block.after, DIAG_UNREACHABLE_CODE);
+        }
+        
+        cfg_free(graph);
+        
+        return PASS_VISIT_NONE;
+    }
+    
+    static int uninitialized_variables_enter(passman& pman, ast_node* node)
+    {
+        if (node->tag != FUNCTION_DECL)
+            return PASS_VISIT_ALL;
+        
+        function* fun = node->decl->as_function;
+        cfg graph = cfg_create(node);
+        
+        std::vector<std::vector<dataflow_access> > accesses = dataflow_accesses(graph, fun);
+        dataflow df = dataflow_definite_assignment(graph, fun, accesses);
+        
+        // Replay each reachable block from its input, and warn once per variable
+        std::vector<bool> warned(fun->variables.size(), false);
+        
+        for (unsigned int rpo = 0; rpo < graph.rpo.size(); ++rpo)
+        {
+            int b = graph.rpo[rpo];
+            bitvec assigned = df.in[b];
+            
+            for (int s = graph.blocks[b].stmt_begin; s < graph.blocks[b].stmt_end; ++s)
+            {
+                for (unsigned int i = 0; i < accesses[s].size(); ++i)
+                {
+                    dataflow_access const& access = accesses[s][i];
+                    
+                    if (access.def)
+                        bitvec_set(assigned, access.var);
+                    else if (!bitvec_get(assigned, access.var) && !warned[access.var])
+                    {
+                        warned[access.var] = true;
+                        pass_warning(pman, access.node, DIAG_UNINITIALIZED_USE, fun->variables[access.var]->name);
+                    }
+                }
+            }
+        }
+        
+        cfg_free(graph);
+        
+        return PASS_VISIT_NONE;
+    }
+    
+    //! Check if an expression can be removed without changing the program :
+    //!   it has no side effects, and no division that may trap.
+    static bool fold_removable(ast_node* node)
+    {
+        switch (node->tag)
+        {
+            case ASSIGNMENT_EXPR:
+            case INC_EXPR:
+            case DEC_EXPR:
+            case FUNCTION_CALL_EXPR:
+                return false;
+            
+            case DIV_EXPR:
+            {
+                ast_node* rhs = node->children[1];
+                if (rhs->tag != INTEGER_LITERAL_EXPR ||
+                    !rhs->as_integer_literal_expr->value || rhs->as_integer_literal_expr->value == -1)
+                    return false;
+                break;
+            }
+        }
+        
+        for (unsigned int i = 0; i < node->children.size(); ++i)
+            if (!fold_removable(node->children[i]))
+                return false;
+        
+        return true;
+    }
+    
+    //! Collect the identifiers of a subtree removed from the AST.
+    static void fold_collect_removed(ast_node* node, std::set<ast_node*>& removed)
+    {
+        if (node->tag == IDENTIFIER_EXPR)
+            removed.insert(node);
+        
+        for (unsigned int i = 0; i < node->children.size(); ++i)
+            fold_collect_removed(node->children[i], removed);
+    }
+    
+    //! Replace an expression by an integer literal.
+    static void fold_to_literal(passman& pman, ast_node* node, int value, std::set<ast_node*>& removed)
+    {
+        integer_literal_expr_node* literal = ast_create<integer_literal_expr_node>(pman.par.ctx.arena, node->saved_tok);
+        literal->value = value;
+        literal->res_tp = node->res_tp;
+        ast_replace(node, literal);
+        
+        fold_collect_removed(node, removed);
+    }
+    
+    //! Replace an expression by one of its operands, dropping the rest of it.
+    //! The operand must have the same result type than the expression.
+    static void fold_to_operand(ast_node* node, int i, std::set<ast_node*>& removed)
+    {
+        ast_node* operand = node->children[i];
+        node->children.erase(node->children.begin() + i);
+        ast_replace(node, operand);
+        
+        fold_collect_removed(node, removed);
+    }
+    
+    //! Fold the constant expressions of a subtree, bottom-up.
+    static void fold_subtree(passman& pman, ast_node* node, std::set<ast_node*>& removed)
+    {
+        // Children are replaced in place
+        for (unsigned int i = 0; i < node->children.size(); ++i)
+            fold_subtree(pman, node->children[i], removed);
+        
+        switch (node->tag)
+        {
+            case NEG_EXPR:
+                if (node->children[0]->tag == INTEGER_LITERAL_EXPR)
+                    fold_to_literal(pman, node, eval_wrap(-(long long) node->children[0]->as_integer_literal_expr->value), removed);
+                break;
+            
+            case ADD_EXPR:
+            case SUB_EXPR:
+            case MUL_EXPR:
+            case DIV_EXPR:
+            {
+                ast_node* lhs = node->children[0];
+                ast_node* rhs = node->children[1];
+                
+                bool lc = lhs->tag == INTEGER_LITERAL_EXPR;
+                bool rc = rhs->tag == INTEGER_LITERAL_EXPR;
+                int l = lc ? lhs->as_integer_literal_expr->value : 0;
+                int r = rc ? rhs->as_integer_literal_expr->value : 0;
+                
+                // Division by zero is left for run time
+                if (node->tag == DIV_EXPR && rc && !r)
+                {
+                    pass_warning(pman, node, DIAG_DIVISION_BY_ZERO);
+                    break;
+                }
+                
+                if (lc && rc)
+                {
+                    switch (node->tag)
+                    {
+                        case ADD_EXPR: fold_to_literal(pman, node, eval_wrap((long long) l + r), removed); break;
+                        case SUB_EXPR: fold_to_literal(pman, node, eval_wrap((long long) l - r), removed); break;
+                        case MUL_EXPR: fold_to_literal(pman, node, eval_wrap((long long) l * r), removed); break;
+                        
+                        // The overflowing division traps at run time too
+                        case DIV_EXPR:
+                            if (l != (int) 0x80000000 || r != -1)
+                                fold_to_literal(pman, node, l / r, removed);
+                            break;
+                    }
+                    break;
+                }
+                
+                // Algebraic identities : x + 0, 0 + x, x - 0, x * 1, 1 * x, x / 1 give x
+                //   and x * 0, 0 * x give 0
+                bool add = node->tag == ADD_EXPR || node->tag == SUB_EXPR;
+                bool mul = node->tag == MUL_EXPR || node->tag == DIV_EXPR;
+                
+                if (rc && ((add && r == 0) || (mul && r == 1)) && lhs->res_tp == node->res_tp)
+                    fold_to_operand(node, 0, removed);
+                else if (lc && node->tag != SUB_EXPR && node->tag != DIV_EXPR &&
+                         ((add && l == 0) || (mul && l == 1)) && rhs->res_tp == node->res_tp)
+                    fold_to_operand(node, 1, removed);
+                else if (node->tag == MUL_EXPR && ((rc && !r && fold_removable(lhs)) || (lc && !l && fold_removable(rhs))))
+                    fold_to_literal(pman, node, 0, removed);
+                break;
+            }
+        }
+    }
+    
+    static int fold_constants_enter(passman&, ast_node* node)
+    {
+        return node->tag == PROGRAM_DECL ? PASS_VISIT_ALL : PASS_VISIT_NONE;
+    }
+    
+    //! The body is folded once all the passes sharing the traversal are done with it.
+    static int fold_constants_leave(passman& pman, ast_node* node)
+    {
+        if (node->tag != FUNCTION_DECL)
+            return PASS_VISIT_NONE;
+        
+        std::set<ast_node*> removed;
+        fold_subtree(pman, node->children[2], removed);
+        
+        // Forget the uses of the removed identifiers (the variables being those
+        //   of the function, they are not shared with other tasks)
+        if (removed.size())
+        {
+            function* fun = node->decl->as_function;
+            
+            for (unsigned int i = 0; i < fun->variables.size(); ++i)
+            {
+                std::vector<ast_node*>& uses = fun->variables[i]->uses;
+                uses.erase(std::remove_if(uses.begin(), uses.end(), [&](ast_node* use) { return removed.count(use) > 0; }),
+                           uses.end());
             }
         }
         
+        return PASS_VISIT_NONE;
+    }
+    
+    //! Evaluate a call at compile time, and replace it by its result.
+    //! Returns true if the call was replaced.
+    static bool evaluate_call(passman& pman, evaluator& ev, function* caller, ast_node* call)
+    {
+        std::map<ast_node*, function*>::iterator it = ev.callees.find(call);
+        if (it == ev.callees.end())
+            return false;
+        
+        function* callee = it->second;
+        if (callee->ret_tp != type_table_builtin(pman.ctx.types, BUILTIN_TYPE_int))
+            return false;
+        
+        // All the arguments must be literals (inner calls are evaluated first)
+        std::vector<ast_node*> arg_nodes;
+        ast_call_arguments(call, arg_nodes);
+        
+        std::vector<int> args;
+        for (unsigned int i = 0; i < arg_nodes.size(); ++i)
+        {
+            if (arg_nodes[i]->tag != INTEGER_LITERAL_EXPR)
+                return false;
+            args.push_back(arg_nodes[i]->as_integer_literal_expr->value);
+        }
+        
+        int result;
+        if (!evaluator_call(ev, callee, args, result))
+            return false;
+        
+        integer_literal_expr_node* literal = ast_create<integer_literal_expr_node>(pman.par.ctx.arena, call->saved_tok);
+        literal->value = result;
+        literal->res_tp = call->res_tp;
+        ast_replace(call, literal);
+        
+        // The call site is gone
+        caller->calls.erase(std::find(caller->calls.begin(), caller->calls.end(), call));
+        callee->uses.erase(std::find(callee->uses.begin(), callee->uses.end(), call));
+        evaluator_forget(ev, call);
+        
+        return true;
+    }
+    
+    static int evaluate_calls_enter(passman& pman, ast_node* node)
+    {
+        if (node->tag != PROGRAM_DECL)
+            return PASS_VISIT_NONE;
+        
+        call_graph graph = call_graph_create(node, summary_functions(pman.ctx.imports));
+        purity_analyze(graph, pman.jobs);
+        evaluator ev = evaluator_create(graph);
+        
+        std::vector<bool> const& reached = pman.reached;
+        
+        // Evaluate inner calls first, so that outer ones may get literal arguments
+        for (unsigned int i = 0; i < node->children.size(); ++i)
+        {
+            if ((reached.size() && !reached[i]) || !node->children[i]->decl)
+                continue;
+            
+            function* fun = node->children[i]->decl->as_function;
+            std::vector<ast_node*> calls = fun->calls;
+            
+            for (unsigned int j = calls.size(); j-- > 0;)
+                evaluate_call(pman, ev, fun, calls[j]);
+        }
+        
+        evaluator_free(ev);
+        call_graph_free(graph);
+        
+        return PASS_VISIT_NONE;
+    }
+    
+    static int lower_ir_enter(passman& pman, ast_node* node)
+    {
+        if (node->tag != PROGRAM_DECL)
+            return PASS_VISIT_NONE;
+        
+        ir_program& ir = pman.ctx.ir;
+        ir_free(ir);
+        ir = ir_create(node);
+        summary_import(pman.ctx.imports, ir);
+        
+        std::vector<bool> const& reached = pman.reached;
+        
         for (unsigned int i = 0; i < node->children.size(); ++i)
-            pass_unused_expression_results(pman, node->children[i]);
+            if ((reached.empty() || reached[i]) && node->children[i]->decl)
+                ir_lower(ir, ir.index[node->children[i]->decl->as_function]);
+        
+        return PASS_VISIT_NONE;
+    }
+    
+    static int build_ssa_enter(passman& pman, ast_node* node)
+    {
+        if (node->tag != PROGRAM_DECL)
+            return PASS_VISIT_NONE;
+        
+        for (unsigned int i = 0; i < pman.ctx.ir.functions.size(); ++i)
+            ssa_construct(pman.ctx.ir, i);
+        
+        return PASS_VISIT_NONE;
+    }
+    
+    static int propagate_constants_enter(passman& pman, ast_node* node)
+    {
+        if (node->tag != PROGRAM_DECL)
+            return PASS_VISIT_NONE;
+        
+        for (unsigned int i = 0; i < pman.ctx.ir.functions.size(); ++i)
+            sccp_run(pman.ctx.ir, i);
+        
+        return PASS_VISIT_NONE;
+    }
+    
+    static int number_values_enter(passman& pman, ast_node* node)
+    {
+        if (node->tag != PROGRAM_DECL)
+            return PASS_VISIT_NONE;
+        
+        for (unsigned int i = 0; i < pman.ctx.ir.functions.size(); ++i)
+            gvn_run(pman.ctx.ir, i);
+        
+        return PASS_VISIT_NONE;
+    }
+    
+    static int eliminate_dead_code_enter(passman& pman, ast_node* node)
+    {
+        if (node->tag != PROGRAM_DECL)
+            return PASS_VISIT_NONE;
+        
+        call_graph graph = call_graph_create(node, summary_functions(pman.ctx.imports));
+        std::vector<bool> removable = dce_removable_calls(pman.ctx.ir, graph);
+        
+        for (unsigned int i = 0; i < pman.ctx.ir.functions.size(); ++i)
+            dce_run(pman.ctx.ir, i, removable);
+        
+        call_graph_free(graph);
+        
+        return PASS_VISIT_NONE;
+    }
+    
+    static int inline_calls_enter(passman& pman, ast_node* node)
+    {
+        if (node->tag != PROGRAM_DECL)
+            return PASS_VISIT_NONE;
+        
+        call_graph graph = call_graph_create(node, summary_functions(pman.ctx.imports));
+        inline_run(pman.ctx.ir, graph);
+        call_graph_free(graph);
+        
+        return PASS_VISIT_NONE;
+    }
+    
+    static int lower_tail_calls_enter(passman& pman, ast_node* node)
+    {
+        if (node->tag != PROGRAM_DECL)
+            return PASS_VISIT_NONE;
+        
+        for (unsigned int i = 0; i < pman.ctx.ir.functions.size(); ++i)
+            tail_run(pman.ctx.ir, i);
+        
+        return PASS_VISIT_NONE;
+    }
+    
+    /****************************/
+    /*** Passes and traversal ***/
+    /****************************/
+    
+    //! Pass handlers depending on the traversal order.
+    #define PASS_HANDLERS_PRE(name) &name ## _enter, 0
+    #define PASS_HANDLERS_POST(name) &name ## _enter, &name ## _leave
+    
+    //! Generate the built-in pass descriptors table.
+    #define DECL_PASS(id, name, order, flags, required, after) \
+        { PASS_ ## id, #name, PASS_ORDER_ ## order, flags, required, after, PASS_HANDLERS_ ## order(name), true, { 0, 0, 0 } },
+    
+    static pass builtin_passes[] =
+    {
+        #include "nut/sem_passes.inc"
+    };
+    
+    #undef DECL_PASS
+    #undef PASS_HANDLERS_POST
+    #undef PASS_HANDLERS_PRE
+    
+    //! Get the current time point, in seconds.
+    static double pass_clock()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    //! The state of a (fused) traversal.
+    //! active: the passes that are still running
+    //! failed: the first pass (in execution order) that failed, PASS_MAX if none
+    //! error:  the exception thrown by the failed pass, for internal errors
+    struct traversal
+    {
+        unsigned int active;
+        int failed;
+        std::exception_ptr error;
+    };
+    
+    //! Record a pass failure during a traversal.
+    //! The failing pass, and all the following ones, are stopped as
+    //!   they would not have been ran if executed one by one.
+    static void traversal_fail(traversal& trv, int id, std::exception_ptr error = std::exception_ptr())
+    {
+        if (id < trv.failed)
+        {
+            trv.failed = id;
+            trv.error = error;
+        }
+        
+        trv.active &= PASS_MASK(id) - 1;
+    }
+    
+    //! Call a pass handler on a node, updating its statistics.
+    //! If leave is false, the enter handler is called and the children to
+    //!   visit are returned, otherwise the leave handler is called.
+    static int traversal_call(passman& pman, traversal& trv, pass& p, ast_node* node, bool leave)
+    {
+        int visit = PASS_VISIT_NONE;
+        double start = pman.timing ? pass_clock() : 0;
+        
+        try
+        {
+            pman.current = p.id;
+            
+            if (leave)
+                visit = p.leave(pman, node);
+            else
+            {
+                ++p.stats.nodes;
+                visit = p.enter(pman, node);
+            }
+            
+            if (visit == PASS_FAILED)
+                traversal_fail(trv, p.id);
+        }
+        catch (...)
+        {
+            traversal_fail(trv, p.id, std::current_exception());
+        }
+        
+        if (pman.timing)
+            p.stats.time += pass_clock() - start;
+        
+        return visit;
+    }
+    
+    //! Call the enter handlers of the given passes on a node.
+    //! The children selected by each pass are written in visit.
+    static void traversal_enter(passman& pman, traversal& trv, ast_node* node, unsigned int mask, int* visit)
+    {
+        for (int id = 0; id < (int) pman.passes.size(); ++id)
+            if (mask & trv.active & PASS_MASK(id))
+                visit[id] = traversal_call(pman, trv, pman.passes[id], node, false);
+    }
+    
+    //! Get the set of passes that selected the i-th child of a node.
+    static unsigned int traversal_child_mask(passman& pman, traversal& trv, unsigned int mask, int* visit, int i)
+    {
+        unsigned int child_mask = 0;
+        for (int id = 0; id < (int) pman.passes.size(); ++id)
+            if ((mask & trv.active & PASS_MASK(id)) && (visit[id] == PASS_VISIT_ALL || visit[id] == i))
+                child_mask |= PASS_MASK(id);
+        
+        return child_mask;
+    }
+    
+    //! Call the leave handlers of the given passes on a node.
+    static void traversal_leave(passman& pman, traversal& trv, ast_node* node, unsigned int mask)
+    {
+        for (int id = 0; id < (int) pman.passes.size(); ++id)
+            if ((mask & trv.active & PASS_MASK(id)) && pman.passes[id].leave)
+                traversal_call(pman, trv, pman.passes[id], node, true);
+    }
+    
+    //! Visit a node with the given set of passes.
+    static void traversal_visit(passman& pman, traversal& trv, ast_node* node, unsigned int mask)
+    {
+        int visit[PASS_MAX];
+        
+        traversal_enter(pman, trv, node, mask, visit);
+        
+        // Visit the children, each one with the passes that selected it
+        for (int i = 0; i < (int) node->children.size(); ++i)
+        {
+            unsigned int child_mask = traversal_child_mask(pman, trv, mask, visit, i);
+            if (child_mask)
+                traversal_visit(pman, trv, node->children[i], child_mask);
+        }
+        
+        traversal_leave(pman, trv, node, mask);
+    }
+    
+    //! The traversal of a function subtree, ran by a worker thread.
+    //! It gets its own copy of the pass manager to collect statistics,
+    //!   diagnostics and resolved uses, merged back once all functions are done.
+    struct traversal_task
+    {
+        traversal_task(passman const& pman) : pman(pman) {}
+        
+        passman pman;
+        traversal trv;
+        unsigned int mask;
+    };
+    
+    //! Visit a program node with the given set of LOCAL passes, each function
+    //!   being visited concurrently (unless a pass is SERIAL).
+    //! If reached is not null, only the functions flagged in it are visited.
+    //! Otherwise the result is the same than the one of traversal_visit.
+    static void traversal_visit_program(passman& pman, traversal& trv, ast_node* node, unsigned int mask,
+                                        std::vector<bool> const* reached)
+    {
+        int visit[PASS_MAX];
+        int n = (int) node->children.size();
+        
+        traversal_enter(pman, trv, node, mask, visit);
+        
+        // Prepare a task per function (LOCAL passes don't need the reached set,
+        //   unreached functions get no task)
+        traversal_task proto(pman);
+        proto.pman.reached.clear();
+        
+        std::vector<traversal_task> tasks(n, proto);
+        for (int i = 0; i < n; ++i)
+        {
+            traversal_task& task = tasks[i];
+            task.trv = trv;
+            task.mask = traversal_child_mask(pman, trv, mask, visit, i);
+            
+            if (reached && !(*reached)[i])
+                task.mask = 0;
+            
+            for (unsigned int id = 0; id < task.pman.passes.size(); ++id)
+            {
+                task.pman.passes[id].stats = pass_stats();
+                task.pman.diags[id].clear();
+            }
+            task.pman.uses.clear();
+            task.pman.calls.clear();
+        }
+        
+        // SERIAL passes change the AST, that the other functions' tasks may read
+        int threads = pman.jobs;
+        for (int id = 0; id < (int) pman.passes.size(); ++id)
+            if ((mask & PASS_MASK(id)) && (pman.passes[id].flags & PASS_FLAG_SERIAL))
+                threads = 1;
+        
+        if (!pman.workers)
+            pman.workers = workers_create(pman.jobs);
+        
+        workers_run(*pman.workers, threads, n, [&](int i)
+        {
+            if (tasks[i].mask)
+                traversal_visit(tasks[i].pman, tasks[i].trv, node->children[i], tasks[i].mask);
+        });
+        
+        // Merge the tasks back in source order, so that the first failure
+        //   of the first failing pass wins, as it would sequentially
+        for (int i = 0; i < n; ++i)
+        {
+            traversal_task& task = tasks[i];
+            
+            for (unsigned int id = 0; id < pman.passes.size(); ++id)
+            {
+                pass_stats& stats = pman.passes[id].stats;
+                stats.time += task.pman.passes[id].stats.time;
+                stats.nodes += task.pman.passes[id].stats.nodes;
+                stats.declarators += task.pman.passes[id].stats.declarators;
+                
+                std::vector<diagnostic>& diags = task.pman.diags[id];
+                pman.diags[id].insert(pman.diags[id].end(), diags.begin(), diags.end());
+            }
+            
+            pman.uses.insert(pman.uses.end(), task.pman.uses.begin(), task.pman.uses.end());
+            pman.calls.insert(pman.calls.end(), task.pman.calls.begin(), task.pman.calls.end());
+            
+            if (task.trv.failed < trv.failed)
+            {
+                trv.failed = task.trv.failed;
+                trv.error = task.trv.error;
+                trv.active &= PASS_MASK(trv.failed) - 1;
+            }
+        }
+        
+        traversal_leave(pman, trv, node, mask);
+    }
+    
+    //! Check if a traversal can be split across functions.
+    //! This is also required to skip the unreached functions.
+    static bool traversal_is_local(passman& pman, unsigned int mask, ast_node* node, bool lazy)
+    {
+        if ((pman.jobs <= 1 && !lazy) || node->tag != PROGRAM_DECL)
+            return false;
+        
+        for (int id = 0; id < (int) pman.passes.size(); ++id)
+            if ((mask & PASS_MASK(id)) && !(pman.passes[id].flags & PASS_FLAG_LOCAL))
+                return false;
+        
+        return true;
+    }
+    
+    //! Run a single traversal with the given set of passes.
+    //! If reached is not null, LOCAL traversals only visit the functions flagged in it.
+    //! Resolved uses and calls are added to their declarators.
+    //! Diagnostics are flushed to the context's sink in pass order, and the eventual
+    //!   internal error is rethrown.
+    //! Diagnostics of the failed pass are kept up to its first error in source order,
+    //!   and those of the following passes are discarded.
+    //! Returns false if a pass failed.
+    static bool traversal_run(passman& pman, unsigned int mask, ast_node* node, std::vector<bool> const* reached)
+    {
+        traversal trv;
+        trv.active = mask;
+        trv.failed = PASS_MAX;
+        
+        if (traversal_is_local(pman, mask, node, reached != 0))
+            traversal_visit_program(pman, trv, node, mask, reached);
+        else
+            traversal_visit(pman, trv, node, mask);
+        
+        diag_sink& sink = pman.par.ctx.diags;
+        for (int id = 0; id < (int) pman.passes.size(); ++id)
+        {
+            std::vector<diagnostic>& diags = pman.diags[id];
+            
+            for (unsigned int i = 0; id <= trv.failed && i < diags.size(); ++i)
+            {
+                diag_emit(sink, diags[i]);
+                if (id == trv.failed && diag_is_error(diags[i]))
+                    break;
+            }
+            
+            diags.clear();
+        }
+        
+        for (unsigned int i = 0; i < pman.uses.size(); ++i)
+            pman.uses[i].first->uses.push_back(pman.uses[i].second);
+        for (unsigned int i = 0; i < pman.calls.size(); ++i)
+            pman.calls[i].first->calls.push_back(pman.calls[i].second);
+        
+        pman.uses.clear();
+        pman.calls.clear();
+        
+        if (trv.error)
+            std::rethrow_exception(trv.error);
+        
+        return trv.failed == PASS_MAX;
+    }
+    
+    //! Print a single line of the time report.
+    static void time_report_line(std::ostream& os, std::string const& name, double time, double total)
+    {
+        os << " " << std::left << std::setw(26) << name << std::right << ": ";
+        os << std::fixed << std::setprecision(6) << std::setw(9) << time;
+        os << " (" << std::setw(3) << (int) (total > 0 ? 100 * time / total + 0.5 : 0) << "%)";
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    passman passman_create(pr::parser& par, context& ctx)
+    {
+        passman pman(par, ctx);
+        
+        pman.jobs = 1;
+        
+        for (unsigned int i = 0; i < sizeof(builtin_passes) / sizeof(pass); ++i)
+            passman_register_pass(pman, builtin_passes[i]);
+        
+        return pman;
+    }
+    
+    void passman_free(passman& pman)
+    {
+        if (pman.workers)
+            workers_free(pman.workers);
+        pman.workers = 0;
+    }
+    
+    int passman_register_pass(passman& pman, pass const& p)
+    {
+        if (pman.passes.size() >= PASS_MAX)
+            throw std::logic_error("sem::passman_register_pass: too many passes");
+        if (!p.enter)
+            throw std::logic_error("sem::passman_register_pass: pass '" + p.name + "' has no enter handler");
+        
+        int id = pman.passes.size();
+        pman.passes.push_back(p);
+        pman.passes[id].id = id;
+        pman.diags.resize(id + 1);
+        
+        return id;
+    }
+    
+    int passman_find_pass(passman& pman, std::string const& name)
+    {
+        for (unsigned int i = 0; i < pman.passes.size(); ++i)
+            if (pman.passes[i].name == name)
+                return i;
+        
+        return -1;
     }
     
-    void pass_unreachable_code(passman& pman, pr::ast_node* node)
+    pass& passman_get_pass(passman& pman, int id)
     {
-        // node->parent is a STATEMENT node wrapper,
-        //   so if node->parent->next != 0, there is another statement after this one
-        if (node->tag == RETURN_STMT && node->parent->next)
-            pass_warning(pman, node, "code is unreachable after this return statement");
+        if (id < 0 || id >= (int) pman.passes.size())
+            throw std::logic_error("sem::passman_get_pass: invalid pass identifier");
         
+        return pman.passes[id];
+    }
+    
+    void passman_enable_pass(passman& pman, int id, bool enabled)
+    {
+        passman_get_pass(pman, id).enabled = enabled;
+    }
+    
+    unsigned int passman_all_passes(passman& pman)
+    {
+        if (pman.passes.size() == PASS_MAX)
+            return ~0u;
+        
+        return PASS_MASK(pman.passes.size()) - 1;
+    }
+    
+    std::vector<bool> passman_reach_functions(passman& pman, ast_node* node)
+    {
+        std::map<std::string, int> functions;
         for (unsigned int i = 0; i < node->children.size(); ++i)
-            pass_unreachable_code(pman, node->children[i]);
+            if (node->children[i]->tag == FUNCTION_DECL)
+                functions[node->children[i]->as_function_decl->name] = i;
+        
+        std::vector<bool> reached(node->children.size(), false);
+        std::vector<std::string> work = pman.roots;
+        
+        for (unsigned int i = 0; i < work.size(); ++i)
+            if (!functions.count(work[i]))
+                throw std::logic_error("unknown root function '" + work[i] + "'");
+        
+        while (work.size())
+        {
+            std::map<std::string, int>::iterator it = functions.find(work.back());
+            work.pop_back();
+            
+            if (it == functions.end() || reached[it->second])
+                continue;
+            
+            reached[it->second] = true;
+            
+            std::vector<ast_node*> calls;
+            ast_collect_calls(node->children[it->second], calls);
+            for (unsigned int i = 0; i < calls.size(); ++i)
+                work.push_back(ast_callee_name(calls[i]));
+        }
+        
+        return reached;
+    }
+    
+    unsigned int passman_skipped_passes(passman& pman)
+    {
+        unsigned int skipped = 0;
+        
+        for (int id = 0; id < (int) pman.passes.size(); ++id)
+        {
+            pass const& p = pman.passes[id];
+            if (!p.enabled || (p.required & skipped))
+                skipped |= PASS_MASK(id);
+        }
+        
+        return skipped;
+    }
+    
+    std::vector<unsigned int> passman_schedule(passman& pman, unsigned int mask)
+    {
+        std::vector<unsigned int> traversals;
+        unsigned int current = 0;
+        unsigned int serial = 0;
+        
+        for (int id = 0; id < (int) pman.passes.size(); ++id)
+            if (pman.passes[id].flags & PASS_FLAG_SERIAL)
+                serial |= PASS_MASK(id);
+        
+        // Only the required sets make a pass depend on others, the after sets
+        //   just order the passes that are scheduled together
+        mask &= ~passman_skipped_passes(pman);
+        
+        for (int id = 0; id < (int) pman.passes.size(); ++id)
+        {
+            if (!(mask & PASS_MASK(id)))
+                continue;
+            
+            pass const& p = pman.passes[id];
+            
+            // A pass can't share the traversal of the passes it requires,
+            //   nor enter a node before the POST passes it comes after leave it,
+            //   and SERIAL passes get their own traversal
+            bool fusable = !(p.required & current) && !(p.flags & PASS_FLAG_SERIAL) && !(serial & current);
+            for (int dep = 0; dep < id; ++dep)
+                if ((p.after & current & PASS_MASK(dep)) && pman.passes[dep].order == PASS_ORDER_POST && p.order == PASS_ORDER_PRE)
+                    fusable = false;
+            
+            if (!fusable && current)
+            {
+                traversals.push_back(current);
+                current = 0;
+            }
+            
+            current |= PASS_MASK(id);
+        }
+        
+        if (current)
+            traversals.push_back(current);
+        
+        return traversals;
+    }
+    
+    bool passman_run(passman& pman, unsigned int mask, pr::ast_node* node)
+    {
+        std::vector<unsigned int> traversals = passman_schedule(pman, mask);
+        
+        bool lazy = pman.roots.size() && node->tag == PROGRAM_DECL;
+        if (lazy)
+            pman.reached = passman_reach_functions(pman, node);
+        
+        for (unsigned int i = 0; i < traversals.size(); ++i)
+            if (!traversal_run(pman, traversals[i], node, lazy ? &pman.reached : 0))
+                return false;
+        
+        return true;
+    }
+    
+    bool passman_run_all(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, passman_all_passes(pman), node);
+    }
+    
+    void passman_time_report(passman& pman, std::ostream& os)
+    {
+        pr::lexer& lex = pman.par.lex;
+        
+        double total = pman.par.time;
+        for (unsigned int i = 0; i < pman.passes.size(); ++i)
+            total += pman.passes[i].stats.time;
+        
+        std::ios::fmtflags flags = os.flags();
+        os << "Execution times (seconds)" << std::endl;
+        
+        time_report_line(os, "lexing", lex.time, total);
+        os << " " << lex.tokens << " tokens" << std::endl;
+        time_report_line(os, "parsing", pman.par.time - lex.time, total);
+        os << std::endl;
+        
+        unsigned int skipped = passman_skipped_passes(pman);
+        for (unsigned int i = 0; i < pman.passes.size(); ++i)
+        {
+            pass& p = pman.passes[i];
+            
+            time_report_line(os, p.name, p.stats.time, total);
+            if (!p.enabled)
+                os << " disabled";
+            else if (skipped & PASS_MASK(i))
+                os << " skipped (requires a disabled pass)";
+            else
+                os << " " << p.stats.nodes << " nodes, " << p.stats.declarators << " declarators";
+            os << std::endl;
+        }
+        
+        time_report_line(os, "TOTAL", total, total);
+        os << std::endl;
+        os.flags(flags);
+    }
+    
+    bool pass_fix_ast(passman& pman, ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_FIX_AST), node);
+    }
+    
+    bool pass_create_declarators(passman& pman, ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_CREATE_DECLARATORS), node);
+    }
+    
+    bool pass_check_calls(passman& pman, ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_CHECK_CALLS), node);
+    }
+    
+    bool pass_resolve_result_types(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_RESOLVE_RESULT_TYPES), node);
+    }
+    
+    bool pass_type_check(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_TYPE_CHECK), node);
+    }
+    
+    bool pass_unused_expression_results(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_UNUSED_EXPRESSION_RESULTS), node);
+    }
+    
+    bool pass_unreachable_code(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_UNREACHABLE_CODE), node);
+    }
+    
+    bool pass_uninitialized_variables(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_UNINITIALIZED_VARIABLES), node);
+    }
+    
+    bool pass_fold_constants(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_FOLD_CONSTANTS), node);
+    }
+    
+    bool pass_evaluate_calls(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_EVALUATE_CALLS), node);
+    }
+    
+    bool pass_lower_ir(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_LOWER_IR), node);
+    }
+    
+    bool pass_build_ssa(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_BUILD_SSA), node);
+    }
+    
+    bool pass_propagate_constants(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_PROPAGATE_CONSTANTS), node);
+    }
+    
+    bool pass_number_values(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_NUMBER_VALUES), node);
+    }
+    
+    bool pass_eliminate_dead_code(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_ELIMINATE_DEAD_CODE), node);
+    }
+    
+    bool pass_inline_calls(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_INLINE_CALLS), node);
+    }
+    
+    bool pass_lower_tail_calls(passman& pman, pr::ast_node* node)
+    {
+        return passman_run(pman, PASS_MASK(PASS_LOWER_TAIL_CALLS), node);
     }
 }
@@ -0,0 +1,144 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_purity.h"
+#include <set>
+#include <algorithm>
+
+namespace sem
+{
+    using namespace pr;
+    
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! The resolved references of a function body.
+    //!
+    //! locals: the IDENTIFIER_EXPR nodes using the function's variables
+    //! calls:  the FUNCTION_CALL_EXPR nodes resolved to a function
+    struct purity_refs
+    {
+        std::set<ast_node*> locals;
+        std::set<ast_node*> calls;
+    };
+    
+    //! Get the effects of assigning the target of an assignment or increment.
+    static int purity_target(purity_refs const& refs, ast_node* target)
+    {
+        if (target->tag == IDENTIFIER_EXPR && refs.locals.count(target))
+            return PURITY_PURE;
+        
+        return PURITY_EFFECTFUL;
+    }
+    
+    //! Get the effects of an AST subtree.
+    static int purity_node(purity_refs const& refs, ast_node* node)
+    {
+        int purity = PURITY_PURE;
+        unsigned int first = 0;
+        
+        switch (node->tag)
+        {
+            case IDENTIFIER_EXPR:
+                if (!refs.locals.count(node))
+                    purity = PURITY_READ_ONLY;
+                break;
+            
+            case ASSIGNMENT_EXPR:
+            case INC_EXPR:
+            case DEC_EXPR:
+                purity = purity_target(refs, node->children[0]);
+                break;
+            
+            //! The callee's effects are added bottom-up, the callee identifier
+            //!   itself is not a read.
+            case FUNCTION_CALL_EXPR:
+                if (!refs.calls.count(node))
+                    purity = PURITY_EFFECTFUL;
+                first = 1;
+                break;
+        }
+        
+        for (unsigned int i = first; i < node->children.size(); ++i)
+            purity = std::max(purity, purity_node(refs, node->children[i]));
+        
+        return purity;
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    int purity_body(function* fun, ast_node* node)
+    {
+        purity_refs refs;
+        
+        for (unsigned int i = 0; i < fun->variables.size(); ++i)
+            refs.locals.insert(fun->variables[i]->uses.begin(), fun->variables[i]->uses.end());
+        refs.calls.insert(fun->calls.begin(), fun->calls.end());
+        
+        // The body is the last child of the FUNCTION_DECL node
+        return purity_node(refs, node->children.back());
+    }
+    
+    void purity_analyze(call_graph& graph, int threads)
+    {
+        call_graph_run_bottom_up(graph, threads, [&](int scc)
+        {
+            std::vector<int> const& members = graph.sccs[scc];
+            int purity = PURITY_PURE;
+            
+            // Calls inside the component add nothing but their bodies
+            for (unsigned int i = 0; i < members.size(); ++i)
+            {
+                call_node& node = graph.nodes[members[i]];
+                purity = std::max(purity, purity_body(node.fun, node.node));
+                
+                for (unsigned int j = 0; j < node.callees.size(); ++j)
+                {
+                    call_node& callee = graph.nodes[node.callees[j].callee];
+                    if (callee.scc != scc)
+                        purity = std::max(purity, callee.fun->purity);
+                }
+                
+                for (unsigned int j = 0; j < node.externals.size(); ++j)
+                    purity = std::max(purity, node.externals[j]->purity);
+            }
+            
+            for (unsigned int i = 0; i < members.size(); ++i)
+                graph.nodes[members[i]].fun->purity = purity;
+        });
+    }
+    
+    char const* purity_name(int purity)
+    {
+        switch (purity)
+        {
+            case PURITY_PURE:      return "pure";
+            case PURITY_READ_ONLY: return "read-only";
+            default:               return "effectful";
+        }
+    }
+    
+    void purity_dump(call_graph& graph, std::ostream& os)
+    {
+        for (unsigned int i = 0; i < graph.nodes.size(); ++i)
+            os << graph.nodes[i].fun->name << ": " << purity_name(graph.nodes[i].fun->purity) << std::endl;
+    }
+}
@@ -0,0 +1,532 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_query.h"
+#include "nut/sem_summary.h"
+#include <iomanip>
+#include <stdexcept>
+
+namespace sem
+{
+    using namespace pr;
+    
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    program_unit::program_unit(std::string const& source) :
+        in(source),
+        ctx(pr::context_create()),
+        sctx(sem::context_create()),
+        lex(lexer_create(in, ctx)),
+        par(parser_create(lex, ctx)),
+        pman(passman_create(par, sctx)),
+        ast(0)
+    { }
+    
+    //! Free a program unit.
+    static void program_unit_free(program_unit* unit)
+    {
+        passman_free(unit->pman);
+        parser_free(unit->par);
+        lexer_free(unit->lex);
+        sem::context_free(unit->sctx);
+        pr::context_free(unit->ctx);
+        
+        delete unit;
+    }
+    
+    //! Hash a string (64-bit FNV-1a), starting from the given hash.
+    static unsigned long long query_hash(std::string const& str, unsigned long long hash = 14695981039346656037ull)
+    {
+        for (unsigned int i = 0; i < str.size(); ++i)
+        {
+            hash ^= (unsigned char) str[i];
+            hash *= 1099511628211ull;
+        }
+        
+        return hash;
+    }
+    
+    //! Create a query that was never computed.
+    static query query_create()
+    {
+        query q;
+        q.fingerprint = 0;
+        q.verified = -1;
+        q.changed = -1;
+        q.failed = false;
+        return q;
+    }
+    
+    //! Get the set of the LOCAL registered passes, or of the non-LOCAL ones that
+    //!   declare the program (the passes requiring LOCAL ones work on whole
+    //!   analyzed programs, and are not ran by queries).
+    static unsigned int query_passes(passman& pman, bool local)
+    {
+        unsigned int locals = 0;
+        for (unsigned int id = 0; id < pman.passes.size(); ++id)
+            if (pman.passes[id].flags & PASS_FLAG_LOCAL)
+                locals |= PASS_MASK(id);
+        
+        if (local)
+            return locals;
+        
+        unsigned int mask = 0;
+        for (unsigned int id = 0; id < pman.passes.size(); ++id)
+            if (!(locals & PASS_MASK(id)) && !(pman.passes[id].required & locals))
+                mask |= PASS_MASK(id);
+        
+        return mask;
+    }
+    
+    //! Find a function declaration in a program unit.
+    //! Returns 0 if not found.
+    static ast_node* unit_function(program_unit* unit, std::string const& name)
+    {
+        if (!unit->ast)
+            return 0;
+        
+        for (unsigned int i = 0; i < unit->ast->children.size(); ++i)
+        {
+            ast_node* node = unit->ast->children[i];
+            if (node->tag == FUNCTION_DECL && node->as_function_decl->name == name)
+                return node;
+        }
+        
+        return 0;
+    }
+    
+    //! Forward declarations.
+    static query& query_update(query_db& db, query_key const& key);
+    
+    //! Get a query, up to date in the current revision.
+    //! It is recorded as a dependency of the active query, if any.
+    static query& query_get(query_db& db, int kind, std::string const& file, std::string const& name = "")
+    {
+        query_key key;
+        key.kind = kind;
+        key.file = file;
+        key.name = name;
+        
+        if (db.active.size())
+        {
+            std::vector<query_key>& deps = db.queries[db.active.back()].deps;
+            
+            bool found = false;
+            for (unsigned int i = 0; i < deps.size() && !found; ++i)
+                found = !(deps[i] < key) && !(key < deps[i]);
+            
+            if (!found)
+                deps.push_back(key);
+        }
+        
+        return query_update(db, key);
+    }
+    
+    //! Create a program unit for a file, from its source and with the database's
+    //!   options, importing its summaries (their sources become dependencies of
+    //!   the active query).
+    //! Throws on unknown pass names and invalid summaries.
+    static program_unit* unit_create(query_db& db, std::string const& file)
+    {
+        query_options const& opts = db.options;
+        program_unit* unit = new program_unit(query_get(db, QUERY_SOURCE, file).text);
+        
+        try
+        {
+            unit->pman.jobs = opts.jobs;
+            unit->pman.roots = opts.roots;
+            
+            for (unsigned int i = 0; i < opts.passes.size(); ++i)
+            {
+                int id = passman_find_pass(unit->pman, opts.passes[i].first);
+                if (id < 0)
+                    throw std::logic_error("unknown pass '" + opts.passes[i].first + "'");
+                
+                passman_enable_pass(unit->pman, id, opts.passes[i].second);
+            }
+            
+            for (unsigned int i = 0; i < opts.imports.size(); ++i)
+            {
+                std::istringstream in(query_get(db, QUERY_SOURCE, opts.imports[i]).text);
+                if (!summary_read(unit->sctx.imports, in))
+                    throw std::logic_error("invalid summary '" + opts.imports[i] + "'");
+            }
+            
+            if (!summary_declare(unit->sctx.imports, unit->sctx))
+                throw std::logic_error("conflicting or invalid imported functions");
+            
+            summary_add_symbols(unit->sctx.imports, unit->ctx.scp);
+        }
+        catch (...)
+        {
+            program_unit_free(unit);
+            throw;
+        }
+        
+        return unit;
+    }
+    
+    /***********************/
+    /*** Query providers ***/
+    /***********************/
+    
+    //! Providers compute a query's value and fingerprint from other queries,
+    //!   obtained with query_get.
+    
+    static void source_provider(query_db&, query_key const&, query& q)
+    {
+        // Files whose source was never set are empty
+        q.text = "";
+        q.fingerprint = query_hash(q.text);
+    }
+    
+    static void program_provider(query_db& db, query_key const& key, query& q)
+    {
+        program_unit* unit = unit_create(db, key.file);
+        
+        if (db.units.count(key.file))
+            program_unit_free(db.units[key.file]);
+        db.units[key.file] = unit;
+        
+        // Parse and declare everything, function bodies are analyzed on demand
+        unit->ast = parser_parse_program(unit->par);
+        q.failed = !unit->ast || !passman_run(unit->pman, query_passes(unit->pman, false), unit->ast);
+        
+        q.fingerprint = query_hash(query_get(db, QUERY_SOURCE, key.file).text);
+    }
+    
+    static void signature_provider(query_db& db, query_key const& key, query& q)
+    {
+        program_unit* unit = query_program(db, key.file);
+        ast_node* node = unit_function(unit, key.name);
+        
+        // Functions that are not in the file may be imported
+        function* fun = node && node->decl ? node->decl->as_function : summary_find(unit->sctx.imports, key.name);
+        
+        q.text = fun ? fun->tp->name : "";
+        q.fingerprint = query_hash(q.text);
+    }
+    
+    static void body_provider(query_db& db, query_key const& key, query& q)
+    {
+        std::string const& source = query_get(db, QUERY_SOURCE, key.file).text;
+        program_unit* unit = query_program(db, key.file);
+        ast_node* node = unit_function(unit, key.name);
+        
+        // A function spans up to the next one
+        q.text = "";
+        if (node)
+        {
+            int start = node->saved_tok.info.offset;
+            int end = node->next ? node->next->saved_tok.info.offset : source.size();
+            q.text = source.substr(start, end - start);
+        }
+        
+        q.fingerprint = query_hash(q.text);
+    }
+    
+    static void body_types_provider(query_db& db, query_key const& key, query& q)
+    {
+        q.fingerprint = query_hash("");
+        
+        if (!query_get(db, QUERY_BODY, key.file, key.name).text.size())
+            return;
+        
+        query_get(db, QUERY_SIGNATURE, key.file, key.name);
+        
+        // The unit is up to date, as the queries above depend on it, but it is not
+        //   a dependency itself : this one only depends on the function's own text
+        //   and on the signatures of the functions it calls
+        program_unit* unit = db.units[key.file];
+        ast_node* node = unit_function(unit, key.name);
+        
+        std::vector<ast_node*> calls;
+        ast_collect_calls(node, calls);
+        for (unsigned int i = 0; i < calls.size(); ++i)
+            query_get(db, QUERY_SIGNATURE, key.file, ast_callee_name(calls[i]));
+        
+        // Run the function-local passes, and take their diagnostics
+        //   back from the unit's sink
+        diag_sink& sink = unit->ctx.diags;
+        int first = sink.diags.size();
+        
+        q.failed = !passman_run(unit->pman, query_passes(unit->pman, true), node);
+        
+        std::ostringstream ss;
+        ss << q.failed;
+        
+        for (unsigned int i = first; i < sink.diags.size(); ++i)
+        {
+            diagnostic diag = sink.diags[i];
+            diag.offset -= node->saved_tok.info.offset;
+            q.diags.push_back(diag);
+            
+            if (diag_is_error(diag))
+                --sink.errors;
+            
+            ss << ";" << diag.id << "," << diag.offset << "," << diag.length;
+            for (int j = 0; j < DIAG_MAX_ARGS; ++j)
+                ss << "," << diag.args[j];
+        }
+        sink.diags.resize(first);
+        
+        q.fingerprint = query_hash(ss.str());
+    }
+    
+    static void ir_provider(query_db& db, query_key const& key, query& q)
+    {
+        // The whole file is analyzed again, in its own unit
+        program_unit* unit = unit_create(db, key.file);
+        std::ostringstream ss;
+        
+        try
+        {
+            unit->ast = parser_parse_program(unit->par);
+            q.failed = !unit->ast || !passman_run_all(unit->pman, unit->ast);
+            
+            if (!q.failed)
+                ir_dump(unit->sctx.ir, ss);
+        }
+        catch (...)
+        {
+            program_unit_free(unit);
+            throw;
+        }
+        
+        program_unit_free(unit);
+        
+        q.text = ss.str();
+        q.fingerprint = query_hash(q.text);
+    }
+    
+    //! Query providers, indexed by query kind.
+    #define DECL_QUERY(id, name) name ## _provider,
+    
+    static void (*query_providers[])(query_db&, query_key const&, query&) =
+    {
+        #include "nut/sem_queries.inc"
+    };
+    
+    #undef DECL_QUERY
+    
+    //! Query names, indexed by query kind.
+    #define DECL_QUERY(id, name) #name,
+    
+    static char const* query_names[] =
+    {
+        #include "nut/sem_queries.inc"
+    };
+    
+    #undef DECL_QUERY
+    
+    //! Check that none of a query's dependencies changed since it was last verified.
+    static bool query_validate(query_db& db, query& q)
+    {
+        for (unsigned int i = 0; i < q.deps.size(); ++i)
+        {
+            query_key dep = q.deps[i];
+            if (query_update(db, dep).changed > q.verified)
+                return false;
+        }
+        
+        return true;
+    }
+    
+    //! Bring a query up to date in the current revision, reusing its value if
+    //!   its dependencies did not change, computing it otherwise.
+    static query& query_update(query_db& db, query_key const& key)
+    {
+        std::map<query_key, query>::iterator it = db.queries.find(key);
+        bool exists = it != db.queries.end();
+        if (!exists)
+            it = db.queries.insert(std::make_pair(key, query_create())).first;
+        
+        query& q = it->second;
+        if (exists && q.verified == db.revision)
+            return q;
+        
+        // Inputs are only changed by query_set_source
+        if (exists && (key.kind == QUERY_SOURCE || query_validate(db, q)))
+        {
+            q.verified = db.revision;
+            ++db.stats[key.kind].reused;
+            return q;
+        }
+        
+        unsigned long long fingerprint = q.fingerprint;
+        q.deps.clear();
+        q.diags.clear();
+        q.failed = false;
+        
+        db.active.push_back(key);
+        try
+        {
+            query_providers[key.kind](db, key, q);
+        }
+        catch (...)
+        {
+            // Don't keep a half-computed query
+            db.active.pop_back();
+            db.queries.erase(key);
+            throw;
+        }
+        db.active.pop_back();
+        
+        if (!exists || q.fingerprint != fingerprint)
+            q.changed = db.revision;
+        q.verified = db.revision;
+        ++db.stats[key.kind].executed;
+        
+        return q;
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    bool operator<(query_key const& a, query_key const& b)
+    {
+        if (a.kind != b.kind)
+            return a.kind < b.kind;
+        if (a.file != b.file)
+            return a.file < b.file;
+        return a.name < b.name;
+    }
+    
+    query_db query_db_create()
+    {
+        query_db db;
+        db.revision = 0;
+        db.options.jobs = 1;
+        
+        for (int i = 0; i < QUERY_COUNT; ++i)
+        {
+            db.stats[i].executed = 0;
+            db.stats[i].reused = 0;
+        }
+        
+        return db;
+    }
+    
+    void query_db_free(query_db& db)
+    {
+        std::map<std::string, program_unit*>::iterator it;
+        for (it = db.units.begin(); it != db.units.end(); ++it)
+            program_unit_free(it->second);
+        
+        db.units.clear();
+        db.queries.clear();
+    }
+    
+    void query_set_source(query_db& db, std::string const& file, std::string const& source)
+    {
+        query_key key;
+        key.kind = QUERY_SOURCE;
+        key.file = file;
+        
+        std::map<query_key, query>::iterator it = db.queries.find(key);
+        if (it != db.queries.end() && it->second.text == source)
+            return;
+        
+        ++db.revision;
+        
+        query& q = db.queries.insert(std::make_pair(key, query_create())).first->second;
+        q.text = source;
+        q.fingerprint = query_hash(source);
+        q.verified = db.revision;
+        q.changed = db.revision;
+    }
+    
+    std::string const& query_source(query_db& db, std::string const& file)
+    {
+        return query_get(db, QUERY_SOURCE, file).text;
+    }
+    
+    program_unit* query_program(query_db& db, std::string const& file)
+    {
+        query_get(db, QUERY_PROGRAM, file);
+        return db.units[file];
+    }
+    
+    std::string const& query_signature(query_db& db, std::string const& file, std::string const& function)
+    {
+        return query_get(db, QUERY_SIGNATURE, file, function).text;
+    }
+    
+    std::string const& query_body(query_db& db, std::string const& file, std::string const& function)
+    {
+        return query_get(db, QUERY_BODY, file, function).text;
+    }
+    
+    query const& query_body_types(query_db& db, std::string const& file, std::string const& function)
+    {
+        return query_get(db, QUERY_BODY_TYPES, file, function);
+    }
+    
+    std::string const& query_ir(query_db& db, std::string const& file)
+    {
+        return query_get(db, QUERY_IR, file).text;
+    }
+    
+    void query_diagnostics(query_db& db, std::string const& file, diag_sink& sink)
+    {
+        program_unit* unit = query_program(db, file);
+        
+        // Parse errors, and diagnostics of the passes ran on the whole program
+        for (unsigned int i = 0; i < unit->ctx.diags.diags.size(); ++i)
+            diag_emit(sink, unit->ctx.diags.diags[i]);
+        
+        if (!unit->ast || unit->ctx.diags.errors)
+            return;
+        
+        // Only the functions reached from the roots are analyzed
+        std::vector<bool> const& reached = unit->pman.reached;
+        
+        for (unsigned int i = 0; i < unit->ast->children.size(); ++i)
+        {
+            if (reached.size() && !reached[i])
+                continue;
+            
+            ast_node* node = unit->ast->children[i];
+            query const& q = query_body_types(db, file, node->as_function_decl->name);
+            
+            for (unsigned int j = 0; j < q.diags.size(); ++j)
+            {
+                diagnostic diag = q.diags[j];
+                diag.offset += node->saved_tok.info.offset;
+                diag_emit(sink, diag);
+            }
+        }
+    }
+    
+    void query_report(query_db& db, std::ostream& os)
+    {
+        std::ios::fmtflags flags = os.flags();
+        os << "Queries (revision " << db.revision << ")" << std::endl;
+        
+        for (int i = 0; i < QUERY_COUNT; ++i)
+        {
+            os << " " << std::left << std::setw(26) << query_names[i] << std::right << ": ";
+            os << db.stats[i].executed << " executed, " << db.stats[i].reused << " reused" << std::endl;
+        }
+        
+        os.flags(flags);
+    }
+}
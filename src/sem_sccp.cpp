@@ -0,0 +1,338 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_sccp.h"
+#include "nut/sem_eval.h"
+
+namespace sem
+{
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! The state of a propagation.
+    //!
+    //! ir, fun:    the program's IR, and the function (in SSA form)
+    //! graph:      the function's control-flow graph
+    //! block_of:   the block of each piece, by offset in the function
+    //! values:     the lattice value of each register
+    //! uses:       the pieces using each register
+    //! executable: the blocks found executable
+    //! edges:      the edges found executable (by index in graph.succs)
+    //! flow:       the edges to process (indices in graph.succs)
+    //! ssa:        the pieces to re-evaluate
+    struct sccp_state
+    {
+        ir_program* ir;
+        int fun;
+        ir_graph graph;
+        std::vector<int> block_of;
+        
+        std::vector<sccp_value> values;
+        std::vector<std::vector<int> > uses;
+        std::vector<bool> executable;
+        std::vector<bool> edges;
+        
+        std::vector<int> flow;
+        std::vector<int> ssa;
+    };
+    
+    //! Build a lattice value.
+    static sccp_value sccp_make(int state, int value = 0)
+    {
+        sccp_value v;
+        v.state = state;
+        v.value = value;
+        return v;
+    }
+    
+    //! Get the lattice value of a target.
+    static sccp_value sccp_get(sccp_state& st, target const& tg)
+    {
+        if (tg.tag == TG_CONSTANT)
+            return sccp_make(SCCP_CONSTANT, tg.value);
+        
+        return st.values[tg.value];
+    }
+    
+    //! Meet two lattice values.
+    static sccp_value sccp_meet(sccp_value a, sccp_value b)
+    {
+        if (a.state == SCCP_TOP)
+            return b;
+        if (b.state == SCCP_TOP)
+            return a;
+        
+        if (a.state == SCCP_CONSTANT && b.state == SCCP_CONSTANT && a.value == b.value)
+            return a;
+        
+        return sccp_make(SCCP_BOTTOM);
+    }
+    
+    //! Evaluate an arithmetic operation on lattice values.
+    static sccp_value sccp_eval(int op, sccp_value a, sccp_value b)
+    {
+        // Anything times zero is zero, even if varying
+        if (op == OP_MUL && ((a.state == SCCP_CONSTANT && !a.value) || (b.state == SCCP_CONSTANT && !b.value)))
+            return sccp_make(SCCP_CONSTANT, 0);
+        
+        bool unary = op == OP_NEG || op == OP_NOT;
+        
+        if (a.state == SCCP_BOTTOM || (!unary && b.state == SCCP_BOTTOM))
+            return sccp_make(SCCP_BOTTOM);
+        if (a.state == SCCP_TOP || (!unary && b.state == SCCP_TOP))
+            return sccp_make(SCCP_TOP);
+        
+        switch (op)
+        {
+            case OP_ADD: return sccp_make(SCCP_CONSTANT, eval_wrap((long long) a.value + b.value));
+            case OP_SUB: return sccp_make(SCCP_CONSTANT, eval_wrap((long long) a.value - b.value));
+            case OP_MUL: return sccp_make(SCCP_CONSTANT, eval_wrap((long long) a.value * b.value));
+            case OP_NEG: return sccp_make(SCCP_CONSTANT, eval_wrap(-(long long) a.value));
+            case OP_NOT: return sccp_make(SCCP_CONSTANT, !a.value);
+            
+            case OP_DIV:
+                if (!b.value || (a.value == (int) 0x80000000 && b.value == -1))
+                    return sccp_make(SCCP_BOTTOM);
+                return sccp_make(SCCP_CONSTANT, a.value / b.value);
+        }
+        
+        return sccp_make(SCCP_BOTTOM);
+    }
+    
+    //! Lower the value of a register, queuing its uses if it changed.
+    static void sccp_update(sccp_state& st, int reg, sccp_value v)
+    {
+        sccp_value& old = st.values[reg];
+        if (old.state == v.state && (v.state != SCCP_CONSTANT || old.value == v.value))
+            return;
+        
+        old = v;
+        st.ssa.insert(st.ssa.end(), st.uses[reg].begin(), st.uses[reg].end());
+    }
+    
+    //! Find the edge from a block to another one.
+    static int sccp_edge(sccp_state& st, int from, int to)
+    {
+        ir_block& block = st.graph.blocks[from];
+        for (int s = block.succ_begin; s < block.succ_end; ++s)
+            if (st.graph.succs[s] == to)
+                return s;
+        
+        return -1;
+    }
+    
+    //! Evaluate a phi, from its values coming through executable edges.
+    static void sccp_visit_phi(sccp_state& st, int bl, int reg)
+    {
+        ir_program& ir = *st.ir;
+        sccp_value v = sccp_make(SCCP_TOP);
+        
+        for (int i = st.graph.blocks[bl].begin + 1; i < st.graph.blocks[bl].end; ++i)
+        {
+            piece& pc = ir.pieces[i];
+            if (pc.op != OP_PHI)
+                break;
+            if (pc.targets[0].value != reg)
+                continue;
+            
+            int edge = sccp_edge(st, st.graph.labels[pc.targets[2].value], bl);
+            if (edge >= 0 && st.edges[edge])
+                v = sccp_meet(v, sccp_get(st, pc.targets[1]));
+        }
+        
+        sccp_update(st, reg, v);
+    }
+    
+    //! Evaluate an operation, in an executable block.
+    static void sccp_visit(sccp_state& st, int offset)
+    {
+        ir_program& ir = *st.ir;
+        int bl = st.block_of[offset - ir.functions[st.fun].begin];
+        piece& pc = ir.pieces[offset];
+        
+        if (pc.tag != PIECE_OPERATION)
+            return;
+        
+        switch (pc.op)
+        {
+            case OP_PHI:
+                sccp_visit_phi(st, bl, pc.targets[0].value);
+                break;
+            
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+                sccp_update(st, pc.targets[0].value, sccp_eval(pc.op, sccp_get(st, pc.targets[1]), sccp_get(st, pc.targets[2])));
+                break;
+            
+            case OP_NEG:
+            case OP_NOT:
+                sccp_update(st, pc.targets[0].value, sccp_eval(pc.op, sccp_get(st, pc.targets[1]), sccp_make(SCCP_TOP)));
+                break;
+            
+            case OP_PUSH_RET:
+                sccp_update(st, pc.targets[0].value, sccp_make(SCCP_BOTTOM));
+                break;
+            
+            case OP_JUMP:
+            {
+                int edge = sccp_edge(st, bl, st.graph.labels[pc.targets[0].value]);
+                if (!st.edges[edge])
+                {
+                    st.edges[edge] = true;
+                    st.flow.push_back(edge);
+                }
+                break;
+            }
+        }
+    }
+    
+    //! Process an edge that became executable : the phis of its destination get
+    //!   a new value, and the whole block is visited the first time it is reached.
+    static void sccp_visit_edge(sccp_state& st, int edge)
+    {
+        ir_program& ir = *st.ir;
+        int bl = st.graph.succs[edge];
+        ir_block& block = st.graph.blocks[bl];
+        
+        if (st.executable[bl])
+        {
+            for (int i = block.begin + 1; i < block.end && ir.pieces[i].op == OP_PHI; ++i)
+                sccp_visit(st, i);
+            return;
+        }
+        
+        st.executable[bl] = true;
+        for (int i = block.begin + 1; i < block.end; ++i)
+            sccp_visit(st, i);
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    int sccp_run(ir_program& ir, int fun)
+    {
+        ir_function& f = ir.functions[fun];
+        if (!f.ssa)
+            return 0;
+        
+        sccp_state st;
+        st.ir = &ir;
+        st.fun = fun;
+        st.graph = ir_graph_create(ir, fun);
+        st.block_of.assign(f.end - f.begin, -1);
+        st.values.assign(f.registers, sccp_make(SCCP_TOP));
+        st.uses.resize(f.registers);
+        st.executable.assign(st.graph.blocks.size(), false);
+        st.edges.assign(st.graph.succs.size(), false);
+        
+        for (unsigned int bl = 0; bl < st.graph.blocks.size(); ++bl)
+        {
+            for (int i = st.graph.blocks[bl].begin; i < st.graph.blocks[bl].end; ++i)
+            {
+                st.block_of[i - f.begin] = bl;
+                
+                piece& pc = ir.pieces[i];
+                if (pc.tag != PIECE_OPERATION)
+                    continue;
+                
+                for (int j = ir_defines(pc) ? 1 : 0; j < pc.count; ++j)
+                    if (pc.targets[j].tag == TG_REGISTER)
+                        st.uses[pc.targets[j].value].push_back(i);
+            }
+        }
+        
+        // The arguments may hold anything
+        for (int i = 0; i < f.fun->argument_count; ++i)
+            st.values[i] = sccp_make(SCCP_BOTTOM);
+        
+        if (st.graph.blocks.size())
+        {
+            ir_block& entry = st.graph.blocks[0];
+            st.executable[0] = true;
+            for (int i = entry.begin + 1; i < entry.end; ++i)
+                sccp_visit(st, i);
+        }
+        
+        while (st.flow.size() || st.ssa.size())
+        {
+            if (st.flow.size())
+            {
+                int edge = st.flow.back();
+                st.flow.pop_back();
+                sccp_visit_edge(st, edge);
+            }
+            else
+            {
+                int offset = st.ssa.back();
+                st.ssa.pop_back();
+                
+                if (st.executable[st.block_of[offset - f.begin]])
+                    sccp_visit(st, offset);
+            }
+        }
+        
+        // Rewrite the executable blocks, without the constant definitions
+        int constants = 0;
+        for (int i = 0; i < f.registers; ++i)
+            if (st.values[i].state == SCCP_CONSTANT)
+                ++constants;
+        
+        std::vector<piece> body;
+        for (unsigned int bl = 0; bl < st.graph.blocks.size(); ++bl)
+        {
+            if (!st.executable[bl])
+                continue;
+            
+            for (int i = st.graph.blocks[bl].begin; i < st.graph.blocks[bl].end; ++i)
+            {
+                piece pc = ir.pieces[i];
+                
+                if (pc.tag == PIECE_OPERATION)
+                {
+                    if (ir_defines(pc) && st.values[pc.targets[0].value].state == SCCP_CONSTANT)
+                        continue;
+                    
+                    if (pc.op == OP_PHI)
+                    {
+                        int edge = sccp_edge(st, st.graph.labels[pc.targets[2].value], bl);
+                        if (edge < 0 || !st.edges[edge])
+                            continue;
+                    }
+                    
+                    for (int j = ir_defines(pc) ? 1 : 0; j < pc.count; ++j)
+                    {
+                        target& tg = pc.targets[j];
+                        if (tg.tag == TG_REGISTER && st.values[tg.value].state == SCCP_CONSTANT)
+                            tg = ir_target(TG_CONSTANT, st.values[tg.value].value);
+                    }
+                }
+                
+                body.push_back(pc);
+            }
+        }
+        
+        ir_graph_free(st.graph);
+        ir_replace(ir, fun, body);
+        
+        return constants;
+    }
+}
@@ -0,0 +1,500 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_ssa.h"
+#include "nut/sem_dataflow.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace sem
+{
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! Find the common dominator of two blocks, walking up the dominator tree
+    //!   being built (Cooper, Harvey and Kennedy's algorithm).
+    static int dom_intersect(ir_graph& graph, std::vector<int>& idom, int a, int b)
+    {
+        while (a != b)
+        {
+            while (graph.blocks[a].rpo > graph.blocks[b].rpo)
+                a = idom[a];
+            while (graph.blocks[b].rpo > graph.blocks[a].rpo)
+                b = idom[b];
+        }
+        
+        return a;
+    }
+    
+    //! The state of a function's conversion to SSA form.
+    //!
+    //! ir, fun:   the program's IR, and the converted function
+    //! graph:     the function's control-flow graph
+    //! dom:       its dominator tree
+    //! preds:     the reachable predecessors of each block
+    //! registers: the number of registers allocated so far
+    //! phis:      the variables having a phi in each block
+    //! phi_regs:  the register of each phi
+    //! phi_args:  the value of each phi, by position in the block's predecessors
+    //! code:      the operations of each block, without its label and phis
+    struct ssa_builder
+    {
+        ir_program* ir;
+        int fun;
+        ir_graph graph;
+        dominators dom;
+        std::vector<std::vector<int> > preds;
+        int registers;
+        
+        std::vector<std::vector<int> > phis;
+        std::vector<std::vector<int> > phi_regs;
+        std::vector<std::vector<std::vector<target> > > phi_args;
+        std::vector<std::vector<piece> > code;
+    };
+    
+    //! Append an operation to a block's code.
+    static void ssa_emit(std::vector<piece>& code, int op, int count,
+                         target first = target(), target second = target(), target third = target())
+    {
+        piece pc;
+        pc.tag = PIECE_OPERATION;
+        pc.op = op;
+        pc.count = count;
+        pc.targets[0] = first;
+        pc.targets[1] = second;
+        pc.targets[2] = third;
+        code.push_back(pc);
+    }
+    
+    //! Pop a value from the simulated operand stack.
+    static target ssa_pop(std::vector<target>& stack)
+    {
+        if (stack.empty())
+            throw std::logic_error("ssa_construct: operand stack underflow");
+        
+        target tg = stack.back();
+        stack.pop_back();
+        return tg;
+    }
+    
+    //! Compute the variables live on entry of each block.
+    static std::vector<bitvec> ssa_liveness(ssa_builder& b, int vars)
+    {
+        ir_program& ir = *b.ir;
+        int n = b.graph.blocks.size();
+        
+        std::vector<bitvec> uses(n, bitvec_create(vars));
+        std::vector<bitvec> defs(n, bitvec_create(vars));
+        std::vector<bitvec> live(n, bitvec_create(vars));
+        
+        for (int bl = 0; bl < n; ++bl)
+        {
+            for (int i = b.graph.blocks[bl].begin; i < b.graph.blocks[bl].end; ++i)
+            {
+                piece& pc = ir.pieces[i];
+                if (pc.tag != PIECE_OPERATION || !pc.count || pc.targets[0].tag != TG_OBJECT)
+                    continue;
+                
+                int var = pc.targets[0].value;
+                if (pc.op == OP_PUSH && !bitvec_get(defs[bl], var))
+                    bitvec_set(uses[bl], var);
+                else if (pc.op == OP_POP)
+                    bitvec_set(defs[bl], var);
+            }
+        }
+        
+        // Backward iteration to a fixed point, in post-order
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            
+            for (unsigned int i = b.graph.rpo.size(); i-- > 0;)
+            {
+                int bl = b.graph.rpo[i];
+                ir_block& block = b.graph.blocks[bl];
+                
+                for (unsigned int w = 0; w < live[bl].words.size(); ++w)
+                {
+                    unsigned long long out = 0;
+                    for (int s = block.succ_begin; s < block.succ_end; ++s)
+                        out |= live[b.graph.succs[s]].words[w];
+                    
+                    unsigned long long in = uses[bl].words[w] | (out & ~defs[bl].words[w]);
+                    if (in != live[bl].words[w])
+                    {
+                        live[bl].words[w] = in;
+                        changed = true;
+                    }
+                }
+            }
+        }
+        
+        return live;
+    }
+    
+    //! Place the phis of each variable at the iterated dominance frontier of its
+    //!   assignments (the entry block assigning all of them), where it is live.
+    static void ssa_place_phis(ssa_builder& b, int vars)
+    {
+        ir_program& ir = *b.ir;
+        int n = b.graph.blocks.size();
+        int entry = b.graph.rpo[0];
+        
+        std::vector<std::vector<int> > defsites(vars, std::vector<int>(1, entry));
+        for (unsigned int i = 1; i < b.graph.rpo.size(); ++i)
+        {
+            int bl = b.graph.rpo[i];
+            for (int j = b.graph.blocks[bl].begin; j < b.graph.blocks[bl].end; ++j)
+            {
+                piece& pc = ir.pieces[j];
+                if (pc.tag == PIECE_OPERATION && pc.op == OP_POP && pc.count)
+                {
+                    std::vector<int>& sites = defsites[pc.targets[0].value];
+                    if (sites.back() != bl)
+                        sites.push_back(bl);
+                }
+            }
+        }
+        
+        std::vector<bitvec> live = ssa_liveness(b, vars);
+        
+        // Blocks are stamped with the variable (plus one) once they got a phi,
+        //   or once they have been queued
+        std::vector<int> has_phi(n, 0);
+        std::vector<int> queued(n, 0);
+        
+        for (int var = 0; var < vars; ++var)
+        {
+            std::vector<int> work = defsites[var];
+            for (unsigned int i = 0; i < work.size(); ++i)
+                queued[work[i]] = var + 1;
+            
+            while (work.size())
+            {
+                int bl = work.back();
+                work.pop_back();
+                
+                for (unsigned int i = 0; i < b.dom.frontier[bl].size(); ++i)
+                {
+                    int df = b.dom.frontier[bl][i];
+                    if (has_phi[df] == var + 1 || !bitvec_get(live[df], var))
+                        continue;
+                    
+                    has_phi[df] = var + 1;
+                    b.phis[df].push_back(var);
+                    
+                    if (queued[df] != var + 1)
+                    {
+                        queued[df] = var + 1;
+                        work.push_back(df);
+                    }
+                }
+            }
+        }
+    }
+    
+    //! Rename the variables and the stack operands of a block, given their values
+    //!   on entry (updated to their values on exit).
+    static void ssa_rename_block(ssa_builder& b, int bl, std::vector<target>& current)
+    {
+        ir_program& ir = *b.ir;
+        ir_block& block = b.graph.blocks[bl];
+        std::vector<piece>& code = b.code[bl];
+        std::vector<target> stack;
+        
+        for (unsigned int k = 0; k < b.phis[bl].size(); ++k)
+        {
+            b.phi_regs[bl][k] = b.registers++;
+            current[b.phis[bl][k]] = ir_target(TG_REGISTER, b.phi_regs[bl][k]);
+        }
+        
+        for (int i = block.begin + 1; i < block.end; ++i)
+        {
+            piece pc = ir.pieces[i];
+            
+            switch (pc.op)
+            {
+                case OP_PUSH:
+                    stack.push_back(pc.targets[0].tag == TG_OBJECT ? current[pc.targets[0].value] : pc.targets[0]);
+                    break;
+                
+                case OP_POP:
+                {
+                    target value = ssa_pop(stack);
+                    if (pc.count)
+                        current[pc.targets[0].value] = value;
+                    break;
+                }
+                
+                case OP_ADD:
+                case OP_SUB:
+                case OP_MUL:
+                case OP_DIV:
+                {
+                    target rhs = ssa_pop(stack);
+                    target lhs = ssa_pop(stack);
+                    target result = ir_target(TG_REGISTER, b.registers++);
+                    
+                    ssa_emit(code, pc.op, 3, result, lhs, rhs);
+                    stack.push_back(result);
+                    break;
+                }
+                
+                case OP_NEG:
+                case OP_NOT:
+                {
+                    target operand = ssa_pop(stack);
+                    target result = ir_target(TG_REGISTER, b.registers++);
+                    
+                    ssa_emit(code, pc.op, 2, result, operand);
+                    stack.push_back(result);
+                    break;
+                }
+                
+                //! The arguments are pushed right before the call.
+                case OP_CALL:
+                case OP_TAIL_CALL:
+                {
+                    int count = pc.targets[1].value;
+                    if ((int) stack.size() < count)
+                        throw std::logic_error("ssa_construct: operand stack underflow");
+                    
+                    for (int j = stack.size() - count; j < (int) stack.size(); ++j)
+                        ssa_emit(code, OP_PUSH, 1, stack[j]);
+                    stack.resize(stack.size() - count);
+                    
+                    code.push_back(pc);
+                    break;
+                }
+                
+                case OP_PUSH_RET:
+                {
+                    target result = ir_target(TG_REGISTER, b.registers++);
+                    
+                    ssa_emit(code, OP_PUSH_RET, 1, result);
+                    stack.push_back(result);
+                    break;
+                }
+                
+                case OP_POP_RET:
+                    ssa_emit(code, OP_POP_RET, 1, ssa_pop(stack));
+                    break;
+                
+                //! Give the successor's phis their value from this block.
+                case OP_JUMP:
+                {
+                    int succ = b.graph.labels[pc.targets[0].value];
+                    std::vector<int>& preds = b.preds[succ];
+                    int pos = std::find(preds.begin(), preds.end(), bl) - preds.begin();
+                    
+                    for (unsigned int k = 0; k < b.phis[succ].size(); ++k)
+                        b.phi_args[succ][k][pos] = current[b.phis[succ][k]];
+                    
+                    code.push_back(pc);
+                    break;
+                }
+                
+                case OP_RETURN:
+                    code.push_back(pc);
+                    break;
+                
+                default:
+                    throw std::logic_error("ssa_construct: unexpected operation");
+            }
+        }
+        
+        if (stack.size())
+            throw std::logic_error("ssa_construct: operand stack not empty at the end of a block");
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    dominators dominators_create(ir_graph& graph)
+    {
+        int n = graph.blocks.size();
+        
+        dominators dom;
+        dom.idom.assign(n, -1);
+        dom.children.resize(n);
+        dom.frontier.resize(n);
+        
+        if (graph.rpo.empty())
+            return dom;
+        
+        int entry = graph.rpo[0];
+        dom.idom[entry] = entry;
+        
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            
+            for (unsigned int i = 1; i < graph.rpo.size(); ++i)
+            {
+                int bl = graph.rpo[i];
+                int idom = -1;
+                
+                for (int p = graph.blocks[bl].pred_begin; p < graph.blocks[bl].pred_end; ++p)
+                {
+                    int pred = graph.preds[p];
+                    if (dom.idom[pred] < 0)
+                        continue;
+                    
+                    idom = idom < 0 ? pred : dom_intersect(graph, dom.idom, idom, pred);
+                }
+                
+                if (idom != dom.idom[bl])
+                {
+                    dom.idom[bl] = idom;
+                    changed = true;
+                }
+            }
+        }
+        
+        for (unsigned int i = 1; i < graph.rpo.size(); ++i)
+            dom.children[dom.idom[graph.rpo[i]]].push_back(graph.rpo[i]);
+        
+        // A join block is in the frontier of the blocks dominating its
+        //   predecessors, up to its immediate dominator
+        for (unsigned int i = 0; i < graph.rpo.size(); ++i)
+        {
+            int bl = graph.rpo[i];
+            ir_block& block = graph.blocks[bl];
+            if (block.pred_end - block.pred_begin < 2)
+                continue;
+            
+            for (int p = block.pred_begin; p < block.pred_end; ++p)
+            {
+                int runner = graph.preds[p];
+                if (graph.blocks[runner].rpo < 0)
+                    continue;
+                
+                while (runner != dom.idom[bl])
+                {
+                    std::vector<int>& frontier = dom.frontier[runner];
+                    if (frontier.empty() || frontier.back() != bl)
+                        frontier.push_back(bl);
+                    
+                    runner = dom.idom[runner];
+                }
+            }
+        }
+        
+        return dom;
+    }
+    
+    void dominators_free(dominators& dom)
+    {
+        dom.idom.clear();
+        dom.children.clear();
+        dom.frontier.clear();
+    }
+    
+    void ssa_construct(ir_program& ir, int fun)
+    {
+        ir_function& f = ir.functions[fun];
+        if (!f.lowered || f.ssa)
+            return;
+        
+        ssa_builder b;
+        b.ir = &ir;
+        b.fun = fun;
+        b.graph = ir_graph_create(ir, fun);
+        b.dom = dominators_create(b.graph);
+        
+        int n = b.graph.blocks.size();
+        int vars = f.fun->variables.size();
+        
+        b.preds.resize(n);
+        for (int bl = 0; bl < n; ++bl)
+            for (int p = b.graph.blocks[bl].pred_begin; p < b.graph.blocks[bl].pred_end; ++p)
+                if (b.graph.blocks[b.graph.preds[p]].rpo >= 0)
+                    b.preds[bl].push_back(b.graph.preds[p]);
+        
+        b.phis.resize(n);
+        b.phi_regs.resize(n);
+        b.phi_args.resize(n);
+        b.code.resize(n);
+        
+        ssa_place_phis(b, vars);
+        
+        for (int bl = 0; bl < n; ++bl)
+        {
+            b.phi_regs[bl].resize(b.phis[bl].size());
+            b.phi_args[bl].assign(b.phis[bl].size(), std::vector<target>(b.preds[bl].size()));
+        }
+        
+        // The arguments are in the first registers, the other variables
+        //   are undefined until assigned (they read as zero)
+        std::vector<target> current(vars);
+        for (int var = 0; var < vars; ++var)
+            current[var] = var < f.fun->argument_count ? ir_target(TG_REGISTER, var) : ir_target(TG_CONSTANT, 0);
+        b.registers = f.fun->argument_count;
+        
+        // Rename along the dominator tree, each block starting from the values
+        //   on exit of its immediate dominator
+        std::vector<std::pair<int, std::vector<target> > > work;
+        work.push_back(std::make_pair(b.graph.rpo[0], current));
+        
+        while (work.size())
+        {
+            int bl = work.back().first;
+            std::vector<target> values;
+            values.swap(work.back().second);
+            work.pop_back();
+            
+            ssa_rename_block(b, bl, values);
+            
+            for (unsigned int i = 0; i < b.dom.children[bl].size(); ++i)
+                work.push_back(std::make_pair(b.dom.children[bl][i], values));
+        }
+        
+        // Assemble the reachable blocks in code order
+        std::vector<piece> body;
+        for (int bl = 0; bl < n; ++bl)
+        {
+            if (b.graph.blocks[bl].rpo < 0)
+                continue;
+            
+            body.push_back(ir.pieces[b.graph.blocks[bl].begin]);
+            
+            for (unsigned int k = 0; k < b.phis[bl].size(); ++k)
+            {
+                for (unsigned int p = 0; p < b.preds[bl].size(); ++p)
+                {
+                    int label = ir.pieces[b.graph.blocks[b.preds[bl][p]].begin].targets[0].value;
+                    ssa_emit(body, OP_PHI, 3, ir_target(TG_REGISTER, b.phi_regs[bl][k]), b.phi_args[bl][k][p],
+                             ir_target(TG_LABEL, label));
+                }
+            }
+            
+            body.insert(body.end(), b.code[bl].begin(), b.code[bl].end());
+        }
+        
+        dominators_free(b.dom);
+        ir_graph_free(b.graph);
+        
+        ir_replace(ir, fun, body);
+        f.ssa = true;
+        f.registers = b.registers;
+    }
+}
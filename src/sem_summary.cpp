@@ -0,0 +1,352 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_summary.h"
+#include "nut/sem_context.h"
+#include "nut/sem_inline.h"
+
+namespace sem
+{
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! Version of the summary format.
+    #define SUMMARY_VERSION 1
+    
+    //! Read a piece of a summary's body.
+    //! Returns false if it is ill-formed.
+    static bool summary_read_piece(std::istream& is, int registers, piece& pc)
+    {
+        if (!(is >> pc.tag >> pc.op >> pc.count))
+            return false;
+        
+        if (pc.tag < PIECE_LABEL || pc.tag > PIECE_OPERATION || pc.op < OP_PUSH || pc.op > OP_TAIL_CALL)
+            return false;
+        if (pc.count < 0 || pc.count > IR_MAX_TARGETS)
+            return false;
+        
+        for (int i = 0; i < pc.count; ++i)
+        {
+            target& tg = pc.targets[i];
+            if (!(is >> tg.tag >> tg.value))
+                return false;
+            
+            if (tg.tag < TG_CONSTANT || tg.tag > TG_REGISTER || tg.tag == TG_OBJECT)
+                return false;
+            if (tg.tag != TG_CONSTANT && (tg.value < 0 || (tg.tag == TG_REGISTER && tg.value >= registers)))
+                return false;
+        }
+        
+        return true;
+    }
+    
+    //! Read a function of a summary, after its "function" keyword.
+    //! Returns false if it is ill-formed.
+    static bool summary_read_function(std::istream& is, summary_function& sf)
+    {
+        int count;
+        if (!(is >> sf.name >> sf.purity >> sf.ret_tp >> count))
+            return false;
+        if (sf.purity < PURITY_PURE || sf.purity > PURITY_EFFECTFUL || count < 0)
+            return false;
+        
+        sf.args_tp.resize(count);
+        for (int i = 0; i < count; ++i)
+            if (!(is >> sf.args_tp[i]))
+                return false;
+        
+        // The arguments are the first registers
+        if (!(is >> sf.registers >> count) || count < 0 || (count && sf.registers < (int) sf.args_tp.size()))
+            return false;
+        
+        sf.body.resize(count);
+        for (int i = 0; i < count; ++i)
+            if (!summary_read_piece(is, sf.registers, sf.body[i]))
+                return false;
+        
+        // A body starts with its entry block
+        if (count && sf.body[0].tag != PIECE_LABEL)
+            return false;
+        
+        sf.decl = 0;
+        return true;
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    summary summary_create(ir_program& ir, call_graph& graph)
+    {
+        summary sum;
+        
+        // The module's own functions, by IR index (imported ones are not part of it)
+        std::vector<int> own(ir.functions.size(), -1);
+        for (unsigned int i = 0; i < ir.functions.size(); ++i)
+        {
+            function* fun = ir.functions[i].fun;
+            if (!ir.functions[i].node)
+                continue;
+            
+            summary_function sf;
+            sf.name = fun->name;
+            sf.purity = fun->purity;
+            sf.ret_tp = fun->ret_tp->name;
+            for (int j = 0; j < fun->argument_count; ++j)
+                sf.args_tp.push_back(fun->arguments[j].tp->name);
+            sf.registers = 0;
+            sf.decl = fun;
+            
+            own[i] = sum.functions.size();
+            sum.index[sf.name] = own[i];
+            sum.functions.push_back(sf);
+        }
+        
+        // Bodies that can't be inlined, or calling other modules, are left out
+        for (unsigned int i = 0; i < ir.functions.size(); ++i)
+        {
+            ir_function& f = ir.functions[i];
+            if (own[i] < 0)
+                continue;
+            
+            std::map<function*, int>::iterator it = graph.index.find(f.fun);
+            if (it == graph.index.end() || call_graph_is_recursive(graph, graph.nodes[it->second].scc))
+                continue;
+            
+            int size = inline_cost(ir, i);
+            if (size < 0 || size > INLINE_SINGLE_SITE_SIZE)
+                continue;
+            
+            std::vector<piece> body(ir.pieces.begin() + f.begin, ir.pieces.begin() + f.end);
+            bool local = true;
+            
+            for (unsigned int j = 0; j < body.size(); ++j)
+            {
+                target& tg = body[j].targets[0];
+                if (body[j].tag == PIECE_OPERATION && (body[j].op == OP_CALL || body[j].op == OP_TAIL_CALL))
+                {
+                    local = local && own[tg.value] >= 0;
+                    tg.value = own[tg.value];
+                }
+            }
+            
+            if (!local)
+                continue;
+            
+            sum.functions[own[i]].registers = f.registers;
+            sum.functions[own[i]].body.swap(body);
+        }
+        
+        return sum;
+    }
+    
+    void summary_free(summary& sum)
+    {
+        sum.functions.clear();
+        sum.index.clear();
+    }
+    
+    void summary_write(summary const& sum, std::ostream& os)
+    {
+        os << "nut-summary " << SUMMARY_VERSION << std::endl;
+        
+        for (unsigned int i = 0; i < sum.functions.size(); ++i)
+        {
+            summary_function const& sf = sum.functions[i];
+            
+            os << "function " << sf.name << " " << sf.purity << " " << sf.ret_tp << " " << sf.args_tp.size();
+            for (unsigned int j = 0; j < sf.args_tp.size(); ++j)
+                os << " " << sf.args_tp[j];
+            os << " " << sf.registers << " " << sf.body.size() << std::endl;
+            
+            for (unsigned int j = 0; j < sf.body.size(); ++j)
+            {
+                piece const& pc = sf.body[j];
+                
+                os << pc.tag << " " << pc.op << " " << pc.count;
+                for (int k = 0; k < pc.count; ++k)
+                    os << " " << pc.targets[k].tag << " " << pc.targets[k].value;
+                os << std::endl;
+            }
+        }
+    }
+    
+    bool summary_read(summary& sum, std::istream& is)
+    {
+        std::string word;
+        int version;
+        if (!(is >> word >> version) || word != "nut-summary" || version != SUMMARY_VERSION)
+            return false;
+        
+        std::vector<summary_function> functions;
+        while (is >> word)
+        {
+            if (word != "function")
+                return false;
+            
+            functions.push_back(summary_function());
+            if (!summary_read_function(is, functions.back()))
+                return false;
+        }
+        
+        // Function targets are moved past the functions already read
+        int base = sum.functions.size();
+        for (unsigned int i = 0; i < functions.size(); ++i)
+        {
+            for (unsigned int j = 0; j < functions[i].body.size(); ++j)
+            {
+                piece& pc = functions[i].body[j];
+                for (int k = 0; k < pc.count; ++k)
+                {
+                    if (pc.targets[k].tag != TG_FUNCTION)
+                        continue;
+                    if (pc.targets[k].value >= (int) functions.size())
+                        return false;
+                    
+                    pc.targets[k].value += base;
+                }
+            }
+        }
+        
+        sum.functions.insert(sum.functions.end(), functions.begin(), functions.end());
+        return true;
+    }
+    
+    bool summary_declare(summary& sum, context& ctx)
+    {
+        for (unsigned int i = 0; i < sum.functions.size(); ++i)
+        {
+            summary_function& sf = sum.functions[i];
+            if (sf.decl)
+                continue;
+            
+            if (sum.index.count(sf.name))
+                return false;
+            
+            type* ret_tp = type_table_find(ctx.types, sf.ret_tp);
+            if (!ret_tp)
+                return false;
+            
+            std::vector<type*> args_tp;
+            for (unsigned int j = 0; j < sf.args_tp.size(); ++j)
+            {
+                args_tp.push_back(type_table_find(ctx.types, sf.args_tp[j]));
+                if (!args_tp.back())
+                    return false;
+            }
+            
+            // Arguments are unnamed, as nothing refers to them
+            function* fun = function_create(ctx.functions, sf.name);
+            fun->ret_tp = ret_tp;
+            fun->arguments = args_tp.size() ? variables_create(ctx.variables, args_tp.size()) : 0;
+            fun->argument_count = args_tp.size();
+            fun->purity = sf.purity;
+            
+            for (int j = 0; j < fun->argument_count; ++j)
+            {
+                fun->arguments[j].tp = args_tp[j];
+                fun->arguments[j].index = j;
+                fun->variables.push_back(&fun->arguments[j]);
+            }
+            
+            fun->tp = type_table_function(ctx.types, ret_tp, args_tp);
+            
+            sf.decl = fun;
+            sum.index[sf.name] = i;
+        }
+        
+        return true;
+    }
+    
+    std::vector<function*> summary_functions(summary& sum)
+    {
+        std::vector<function*> functions;
+        for (unsigned int i = 0; i < sum.functions.size(); ++i)
+            if (sum.functions[i].decl)
+                functions.push_back(sum.functions[i].decl);
+        
+        return functions;
+    }
+    
+    void summary_add_symbols(summary& sum, pr::scope& scp)
+    {
+        std::vector<function*> functions = summary_functions(sum);
+        for (unsigned int i = 0; i < functions.size(); ++i)
+        {
+            pr::symbol sym;
+            sym.name = functions[i]->name;
+            sym.flags = pr::SYM_FLAG_FUNCTION;
+            pr::scope_add(scp, sym);
+        }
+    }
+    
+    function* summary_find(summary& sum, std::string const& name)
+    {
+        std::map<std::string, int>::iterator it = sum.index.find(name);
+        if (it == sum.index.end())
+            return 0;
+        
+        return sum.functions[it->second].decl;
+    }
+    
+    void summary_import(summary& sum, ir_program& ir)
+    {
+        for (unsigned int i = 0; i < sum.functions.size(); ++i)
+        {
+            function* fun = sum.functions[i].decl;
+            if (!fun)
+                continue;
+            
+            ir_function f;
+            f.fun = fun;
+            f.node = 0;
+            f.lowered = false;
+            f.begin = f.end = 0;
+            f.ssa = false;
+            f.registers = 0;
+            
+            ir.index[fun] = ir.functions.size();
+            ir.functions.push_back(f);
+            
+            for (unsigned int j = 0; j < fun->uses.size(); ++j)
+                ir.callees[fun->uses[j]] = fun;
+        }
+        
+        // Their bodies are already in SSA form, calling each other
+        for (unsigned int i = 0; i < sum.functions.size(); ++i)
+        {
+            summary_function& sf = sum.functions[i];
+            if (!sf.decl || sf.body.empty())
+                continue;
+            
+            std::vector<piece> body = sf.body;
+            for (unsigned int j = 0; j < body.size(); ++j)
+                for (int k = 0; k < body[j].count; ++k)
+                    if (body[j].targets[k].tag == TG_FUNCTION)
+                        body[j].targets[k].value = ir.index[sum.functions[body[j].targets[k].value].decl];
+            
+            int fun = ir.index[sf.decl];
+            ir.functions[fun].lowered = true;
+            ir.functions[fun].ssa = true;
+            ir.functions[fun].registers = sf.registers;
+            
+            ir_replace(ir, fun, body);
+        }
+    }
+}
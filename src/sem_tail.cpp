@@ -0,0 +1,192 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "nut/sem_tail.h"
+
+namespace sem
+{
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! Append a piece, with up to three targets.
+    static void tail_emit(std::vector<piece>& code, int tag, int op, int count,
+                          target first = target(), target second = target(), target third = target())
+    {
+        piece pc;
+        pc.tag = tag;
+        pc.op = op;
+        pc.count = count;
+        pc.targets[0] = first;
+        pc.targets[1] = second;
+        pc.targets[2] = third;
+        code.push_back(pc);
+    }
+    
+    //! Find the call in tail position ending a reachable block : a CALL, its
+    //!   PUSH_RET then the POP_RET of the same register, and a jump to a block
+    //!   holding nothing but the return.
+    //! Returns the offset of the CALL piece, or -1 if there is none.
+    static int tail_find(ir_program& ir, ir_graph& graph, int bl)
+    {
+        ir_block& block = graph.blocks[bl];
+        if (block.rpo < 0 || block.end - block.begin < 5)
+            return -1;
+        
+        piece& jump = ir.pieces[block.end - 1];
+        if (jump.op != OP_JUMP)
+            return -1;
+        
+        ir_block& next = graph.blocks[graph.labels[jump.targets[0].value]];
+        if (next.end - next.begin != 2 || ir.pieces[next.end - 1].op != OP_RETURN)
+            return -1;
+        
+        piece* pc = &ir.pieces[block.end - 4];
+        if (pc[0].op != OP_CALL || pc[1].op != OP_PUSH_RET || pc[2].op != OP_POP_RET)
+            return -1;
+        if (pc[2].targets[0].tag != TG_REGISTER || pc[2].targets[0].value != pc[1].targets[0].value)
+            return -1;
+        
+        return block.end - 4;
+    }
+    
+    //! Rename an argument register to its phi's register, past 'base'.
+    static target tail_rename(target tg, int args, int base)
+    {
+        if (tg.tag == TG_REGISTER && tg.value < args)
+            tg.value += base;
+        return tg;
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    int tail_run(ir_program& ir, int fun)
+    {
+        ir_function& f = ir.functions[fun];
+        if (!f.lowered || !f.ssa)
+            return 0;
+        
+        ir_graph graph = ir_graph_create(ir, fun);
+        int n = graph.blocks.size();
+        
+        // The calls in tail position, and the jumps left to each block from the
+        //   reachable ones once they are lowered
+        std::vector<int> calls(n, -1);
+        std::vector<int> preds(n, 0);
+        int count = 0;
+        int args = 0;
+        bool loop = false;
+        
+        for (int bl = 0; bl < n; ++bl)
+        {
+            calls[bl] = tail_find(ir, graph, bl);
+            if (calls[bl] >= 0)
+            {
+                if (ir.pieces[calls[bl]].targets[0].value == fun)
+                {
+                    args = ir.pieces[calls[bl]].targets[1].value;
+                    loop = true;
+                }
+                ++count;
+            }
+            else if (graph.blocks[bl].rpo >= 0)
+            {
+                for (int i = graph.blocks[bl].succ_begin; i < graph.blocks[bl].succ_end; ++i)
+                    ++preds[graph.succs[i]];
+            }
+        }
+        
+        if (!count)
+        {
+            ir_graph_free(graph);
+            return 0;
+        }
+        
+        // With a loop, the arguments get phis at the former entry block, from the
+        //   new one and from each recursive call
+        int base = f.registers;
+        int entry = ir.pieces[f.begin].targets[0].value;
+        int prologue = f.labels.size();
+        
+        std::vector<std::vector<piece> > phis(args);
+        for (int i = 0; i < args; ++i)
+            tail_emit(phis[i], PIECE_OPERATION, OP_PHI, 3, ir_target(TG_REGISTER, base + i),
+                      ir_target(TG_REGISTER, i), ir_target(TG_LABEL, prologue));
+        
+        // Rewrite the blocks, without the returning ones nothing jumps to anymore
+        std::vector<piece> body;
+        for (int bl = 0; bl < n; ++bl)
+        {
+            ir_block& block = graph.blocks[bl];
+            if (block.rpo < 0 || (bl && !preds[bl]))
+                continue;
+            
+            int call = calls[bl];
+            int end = call >= 0 ? call : block.end;
+            bool self = call >= 0 && ir.pieces[call].targets[0].value == fun;
+            
+            // The arguments of a recursive call go to the phis instead
+            if (self)
+                end -= ir.pieces[call].targets[1].value;
+            
+            for (int i = block.begin; i < end; ++i)
+            {
+                piece pc = ir.pieces[i];
+                if (pc.tag == PIECE_OPERATION)
+                    for (int j = ir_defines(pc) ? 1 : 0; j < pc.count; ++j)
+                        pc.targets[j] = tail_rename(pc.targets[j], args, base);
+                
+                body.push_back(pc);
+            }
+            
+            if (self)
+            {
+                for (int i = 0; i < args; ++i)
+                    tail_emit(phis[i], PIECE_OPERATION, OP_PHI, 3, ir_target(TG_REGISTER, base + i),
+                              tail_rename(ir.pieces[end + i].targets[0], args, base), ir.pieces[block.begin].targets[0]);
+                
+                tail_emit(body, PIECE_OPERATION, OP_JUMP, 1, ir_target(TG_LABEL, entry));
+            }
+            else if (call >= 0)
+                tail_emit(body, PIECE_OPERATION, OP_TAIL_CALL, 2, ir.pieces[call].targets[0], ir.pieces[call].targets[1]);
+        }
+        
+        if (loop)
+        {
+            std::vector<piece> head;
+            tail_emit(head, PIECE_LABEL, 0, 1, ir_target(TG_LABEL, prologue));
+            tail_emit(head, PIECE_OPERATION, OP_JUMP, 1, ir_target(TG_LABEL, entry));
+            head.push_back(body[0]);
+            
+            for (int i = 0; i < args; ++i)
+                head.insert(head.end(), phis[i].begin(), phis[i].end());
+            
+            body.erase(body.begin());
+            body.insert(body.begin(), head.begin(), head.end());
+            f.registers += args;
+        }
+        
+        ir_graph_free(graph);
+        ir_replace(ir, fun, body);
+        
+        return count;
+    }
+}
@@ -0,0 +1,132 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_types.h"
+#include <sstream>
+
+namespace sem
+{
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! Add a new type to the table, giving it its identifier.
+    static type* type_table_add(type_table& table, type* tp)
+    {
+        tp->id = table.types.size();
+        table.types.push_back(tp);
+        return tp;
+    }
+    
+    //! Intern a derived type.
+    //! Derived types are keyed by their kind, followed by the identifiers of
+    //!   their base type and their length or argument types.
+    //! If the key is not found, the type is created by calling make.
+    template <typename Make>
+    static type* type_table_intern(type_table& table, std::vector<int> const& key, Make make)
+    {
+        std::map<std::vector<int>, type*>::iterator it = table.derived.find(key);
+        if (it != table.derived.end())
+            return it->second;
+        
+        type* tp = type_table_add(table, make());
+        table.derived[key] = tp;
+        return tp;
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    type_table type_table_create()
+    {
+        type_table table;
+        
+        #define DECL_BUILTIN_TYPE(nm, fl) \
+            table.names[#nm] = type_table_add(table, type_create(#nm, fl));
+        
+        #include "nut/sem_builtins.inc"
+        
+        #undef DECL_BUILTIN_TYPE
+        
+        return table;
+    }
+    
+    void type_table_free(type_table& table)
+    {
+        for (unsigned int i = 0; i < table.types.size(); ++i)
+            type_free(table.types[i]);
+        
+        table.types.clear();
+        table.names.clear();
+        table.derived.clear();
+    }
+    
+    type* type_table_find(type_table& table, std::string const& name)
+    {
+        std::map<std::string, type*>::iterator it = table.names.find(name);
+        if (it == table.names.end())
+            return 0;
+        
+        return it->second;
+    }
+    
+    type* type_table_array(type_table& table, type* element, int length)
+    {
+        std::vector<int> key;
+        key.push_back(TYPE_KIND_ARRAY);
+        key.push_back(element->id);
+        key.push_back(length);
+        
+        return type_table_intern(table, key, [&]()
+        {
+            std::ostringstream ss;
+            ss << element->name << "[" << length << "]";
+            
+            type* tp = type_create(ss.str());
+            tp->kind = TYPE_KIND_ARRAY;
+            tp->base = element;
+            tp->length = length;
+            return tp;
+        });
+    }
+    
+    type* type_table_function(type_table& table, type* ret, std::vector<type*> const& arguments)
+    {
+        std::vector<int> key;
+        key.push_back(TYPE_KIND_FUNCTION);
+        key.push_back(ret->id);
+        for (unsigned int i = 0; i < arguments.size(); ++i)
+            key.push_back(arguments[i]->id);
+        
+        return type_table_intern(table, key, [&]()
+        {
+            std::ostringstream ss;
+            ss << ret->name << "(";
+            for (unsigned int i = 0; i < arguments.size(); ++i)
+                ss << (i ? ", " : "") << arguments[i]->name;
+            ss << ")";
+            
+            type* tp = type_create(ss.str());
+            tp->kind = TYPE_KIND_FUNCTION;
+            tp->base = ret;
+            tp->arguments = arguments;
+            return tp;
+        });
+    }
+}
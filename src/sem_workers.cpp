@@ -0,0 +1,267 @@
+/* This file is part of nut.
+ * 
+ * Copyright (c) 2015, Alexandre Monti
+ * 
+ * nut is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * nut is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with nut.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nut/sem_workers.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <exception>
+
+namespace sem
+{
+    /**************************************/
+    /*** Private implementation section ***/
+    /**************************************/
+    
+    //! A worker's task queue.
+    struct worker_queue
+    {
+        std::mutex lock;
+        std::deque<int> tasks;
+    };
+    
+    //! The state shared by the workers of a run.
+    struct workers
+    {
+        std::function<void(int)> const* task;
+        std::vector<worker_queue> queues;
+        
+        //! Exceptions thrown by the tasks, indexed by task.
+        std::vector<std::exception_ptr> errors;
+    };
+    
+    //! Pop a task from the back of a worker's own queue.
+    //! Returns -1 if the queue is empty.
+    static int worker_pop(worker_queue& queue)
+    {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        
+        if (queue.tasks.empty())
+            return -1;
+        
+        int task = queue.tasks.back();
+        queue.tasks.pop_back();
+        return task;
+    }
+    
+    //! Steal a task from the front of another worker's queue.
+    //! Returns -1 if the queue is empty.
+    static int worker_steal(worker_queue& queue)
+    {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        
+        if (queue.tasks.empty())
+            return -1;
+        
+        int task = queue.tasks.front();
+        queue.tasks.pop_front();
+        return task;
+    }
+    
+    //! A worker's main loop.
+    //! As no task is added during a run, the worker can stop as soon as
+    //!   all the queues are empty.
+    static void worker_main(workers& wks, int self)
+    {
+        int n = (int) wks.queues.size();
+        
+        for (;;)
+        {
+            int task = worker_pop(wks.queues[self]);
+            
+            // Look for some work in the other queues
+            for (int i = 1; task < 0 && i < n; ++i)
+                task = worker_steal(wks.queues[(self + i) % n]);
+            
+            if (task < 0)
+                break;
+            
+            try
+            {
+                (*wks.task)(task);
+            }
+            catch (...)
+            {
+                wks.errors[task] = std::current_exception();
+            }
+        }
+    }
+    
+    //! A pool of worker threads.
+    //! Its threads wait for a new run, work on it as workers 1, 2, ... (the
+    //!   calling thread being worker 0), and report when they are done.
+    struct worker_pool
+    {
+        std::vector<std::thread> threads;
+        
+        std::mutex lock;
+        std::condition_variable wake;
+        std::condition_variable done;
+        
+        //! The current run, and its number (incremented for each run).
+        workers* run;
+        unsigned long generation;
+        //! Number of threads still working on the current run.
+        int busy;
+        //! Set to stop the threads.
+        bool stop;
+    };
+    
+    //! A pool thread's main loop.
+    //! Threads that are not needed by a run (see workers_run) skip it, and may
+    //!   only wake up once it is over.
+    static void pool_main(worker_pool& pool, int self)
+    {
+        unsigned long seen = 0;
+        
+        for (;;)
+        {
+            workers* wks;
+            {
+                std::unique_lock<std::mutex> guard(pool.lock);
+                pool.wake.wait(guard, [&] { return pool.stop || pool.generation != seen; });
+                
+                if (pool.stop)
+                    return;
+                
+                seen = pool.generation;
+                wks = pool.run;
+            }
+            
+            if (!wks || self >= (int) wks->queues.size())
+                continue;
+            
+            worker_main(*wks, self);
+            
+            std::lock_guard<std::mutex> guard(pool.lock);
+            if (--pool.busy == 0)
+                pool.done.notify_one();
+        }
+    }
+    
+    /*************************/
+    /*** Public module API ***/
+    /*************************/
+    
+    int workers_default_count()
+    {
+        int count = std::thread::hardware_concurrency();
+        return count > 0 ? count : 1;
+    }
+    
+    void workers_run(int threads, int count, std::function<void(int)> const& task)
+    {
+        if (threads > count)
+            threads = count;
+        
+        // Nothing to share, don't even create the threads
+        if (threads <= 1)
+        {
+            for (int i = 0; i < count; ++i)
+                task(i);
+            return;
+        }
+        
+        worker_pool* pool = workers_create(threads);
+        try
+        {
+            workers_run(*pool, threads, count, task);
+        }
+        catch (...)
+        {
+            workers_free(pool);
+            throw;
+        }
+        workers_free(pool);
+    }
+    
+    worker_pool* workers_create(int threads)
+    {
+        worker_pool* pool = new worker_pool;
+        pool->run = 0;
+        pool->generation = 0;
+        pool->busy = 0;
+        pool->stop = false;
+        
+        for (int i = 1; i < threads; ++i)
+            pool->threads.push_back(std::thread(pool_main, std::ref(*pool), i));
+        
+        return pool;
+    }
+    
+    void workers_free(worker_pool* pool)
+    {
+        {
+            std::lock_guard<std::mutex> guard(pool->lock);
+            pool->stop = true;
+        }
+        pool->wake.notify_all();
+        
+        for (unsigned int i = 0; i < pool->threads.size(); ++i)
+            pool->threads[i].join();
+        
+        delete pool;
+    }
+    
+    void workers_run(worker_pool& pool, int threads, int count, std::function<void(int)> const& task)
+    {
+        if (threads > count)
+            threads = count;
+        if (threads > (int) pool.threads.size() + 1)
+            threads = pool.threads.size() + 1;
+        
+        // Nothing to share, run in the calling thread
+        if (threads <= 1)
+        {
+            for (int i = 0; i < count; ++i)
+                task(i);
+            return;
+        }
+        
+        workers wks;
+        wks.task = &task;
+        wks.queues = std::vector<worker_queue>(threads);
+        wks.errors.resize(count);
+        
+        // Give each worker a contiguous range of tasks
+        for (int i = 0; i < count; ++i)
+            wks.queues[(long) i * threads / count].tasks.push_back(i);
+        
+        {
+            std::lock_guard<std::mutex> guard(pool.lock);
+            pool.run = &wks;
+            pool.busy = threads - 1;
+            ++pool.generation;
+        }
+        pool.wake.notify_all();
+        
+        worker_main(wks, 0);
+        
+        {
+            std::unique_lock<std::mutex> guard(pool.lock);
+            pool.done.wait(guard, [&] { return pool.busy == 0; });
+            pool.run = 0;
+        }
+        
+        for (int i = 0; i < count; ++i)
+            if (wks.errors[i])
+                std::rethrow_exception(wks.errors[i]);
+    }
+}